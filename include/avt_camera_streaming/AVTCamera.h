@@ -0,0 +1,125 @@
+/*=========================================================
+Created by Hui Xiao - University of Connecticuit - 2019
+hui.xiao@uconn.edu
+===========================================================*/
+
+#ifndef AVTCAMERA
+#define AVTCAMERA
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "VimbaCPP/Include/VimbaCPP.h"
+#include "ros/ros.h"
+#include "avt_camera_streaming/CamParam.h"
+#include "avt_camera_streaming/MessagePublisher.h"
+#include "avt_camera_streaming/FrameWorker.h"
+#include "avt_camera_streaming/FramePool.h"
+#include "avt_camera_streaming/DebayerEngine.h"
+#include "avt_camera_streaming/ConversionTable.h"
+#include "avt_camera_streaming/ColorCorrection.h"
+#include "avt_camera_streaming/TimingDiagnostics.h"
+#include "avt_camera_streaming/Rectifier.h"
+#include "avt_camera_streaming/TriggerListener.h"
+#include "avt_camera_streaming/CommandRunner.h"
+#include "avt_camera_streaming/TriggerTracker.h"
+#include "camera_info_manager/camera_info_manager.h"
+#include "sensor_msgs/CameraInfo.h"
+#include "sensor_msgs/TimeReference.h"
+#include "std_msgs/String.h"
+#include "std_msgs/ColorRGBA.h"
+
+// One camera: parameters, acquisition, conversion and publishing.
+// Used by avt_triggering, avt_stereo and the nodelet, which differ only in the node handles
+// they pass: nh for topics (trigger, images), private_nh for the parameters and ~white_balance.
+// Any number of cameras can live in one process, they share one VimbaSystem and the ThreadPool.
+class AVTCamera
+{
+public:
+    // subscribe_trigger = false: the owner calls TriggerImage() itself, e.g. once for all cameras of a rig.
+    // Otherwise nh's trigger topic is served by a TriggerListener thread, see TriggerListener.h.
+    AVTCamera(ros::NodeHandle nh, ros::NodeHandle private_nh, const std::string &topic = "avt_camera_img", bool subscribe_trigger = true);
+
+    // gets the main image (avt_camera_img) of every frame instead of it being published, e.g. to
+    // pair it with another camera first, together with the match image if one was made (else NULL).
+    // Runs on the worker thread. Set before StartAcquisition().
+    typedef std::function<void(const sensor_msgs::ImagePtr &image, const sensor_msgs::ImagePtr &match, unsigned long long ts_cam)> ImageHandler;
+    void SetImageHandler(const ImageHandler &handler) { image_handler = handler; }
+    // Also make a mono8 image for stereo matching while wanted() returns true: rectified, cut to
+    // roi and shrunk by downscale, straight from the Bayer mosaic in one fused pass.
+    // Needs the calibration (~camera_info_url). Call before StartAcquisition().
+    bool EnableMatchImage(int downscale, const cv::Rect &roi, const std::function<bool()> &wanted);
+    // geometry of the match images
+    const Rectifier &MatchRectifier() const { return match_rectifier; }
+    // publish on the main image topic, for whoever took the image through the handler.
+    // The camera_info goes out with it, with the same stamp, and so does the trigger_info if
+    // header.seq still holds the trigger sequence number ProcessFrame put there.
+    void PublishImage(const sensor_msgs::ImagePtr &image, unsigned long long ts_cam);
+
+    void StartAcquisition();
+    void StopAcquisition();
+    void SetCameraFeature();
+    //call this function triggers an image
+    // Safe from any thread; does nothing while not acquiring.
+    void TriggerImage();
+    // shortest time between two frames with the current exposure and frame rate limits, 0 if the
+    // camera does not tell. Known once acquiring.
+    double MinFramePeriod() const { return min_frame_period; }
+    // ~ptp_mode is not Off, so the frame timestamps are on a clock shared with other cameras
+    bool PtpEnabled() const { return cam_param.ptp_mode != "Off"; }
+private:
+    // convert, publish and re-queue one frame. Runs on the FrameWorker thread.
+    void ProcessFrame(FrameLease &lease);
+    // new white balance gains in r, g, b (a is ignored), applied from the next frame on
+    void whiteBalanceCb(const std_msgs::ColorRGBA::ConstPtr& gains);
+    // load ~camera_info_url, advertise camera_info and prepare the rectification maps
+    void loadCalibration();
+    // this function fetch parameters from ROS server
+    void getParams(ros::NodeHandle &n, CameraParam &cp);
+    void SetCameraImageSize(const VmbInt64_t& width, const VmbInt64_t& height, const VmbInt64_t& offsetX, const VmbInt64_t& offsetY, const VmbInt64_t& binninghorizontal, const VmbInt64_t& binningvertical);
+    void SetExposureTime(const VmbInt64_t & time_in_us);
+    void SetAcquisitionFramRate(const double & fps);
+    void SetGain(const VmbInt64_t & gain);
+    // from ExposureTimeAbs and the range of AcquisitionFrameRateAbs, as the camera has them now
+    double QueryMinFramePeriod();
+
+    CameraParam cam_param;
+    VmbInt64_t nPLS; // Payload size value
+    double min_frame_period; // seconds, see MinFramePeriod()
+    AVT::VmbAPI::FeaturePtr pFeature; // Generic feature pointer
+    AVT::VmbAPI::VimbaSystem &sys;
+    AVT::VmbAPI::CameraPtr camera;
+    FramePool frame_pool; // frame buffers announced to the camera
+    ros::NodeHandle n;   // private node handle, for parameters
+    ros::NodeHandle nn;  // node namespace, for the trigger topic
+    CommandRunner commands; // every feature write and command, bounded by ~command_timeout_ms
+    std::mutex trigger_mutex; // TriggerImage against StartAcquisition and StopAcquisition
+    AVT::VmbAPI::FeaturePtr trigger_feature; // TriggerSoftware while acquiring, else NULL
+    TriggerTracker trigger_tracker; // numbers the triggers and matches the frames to them
+    bool track_triggers; // trigger_source is Software
+    std::unique_ptr<TriggerListener> trigger; // NULL if the owner triggers; after the two above, so its thread stops first
+    ros::Subscriber white_balance_sub;
+    MessagePublisher image_pub;  // image publisher class. Using image_transport api.
+    std::unique_ptr<FrameWorker> worker; // takes frames off the transport thread
+    DebayerEngine debayer; // color conversion in bands on the shared thread pool
+    ConversionTable conversions; // kernel for each (pixel format, output encoding)
+    OutputEncoding output_encoding;
+    ColorCorrection color_correction; // white balance and gamma, folded into the conversion
+    bool mono_full_res; // mono topic from the interpolated green channel instead of 2x2 luma
+    ImageHandler image_handler;
+    std::unique_ptr<camera_info_manager::CameraInfoManager> info_manager; // NULL without ~camera_info_url
+    sensor_msgs::CameraInfo camera_info; // as loaded, published with every main image
+    sensor_msgs::CameraInfoPtr camera_info_msg; // reused like the image messages
+    std::mutex camera_info_mutex; // PublishImage may run on either camera's thread of a stereo pair
+    ros::Publisher camera_info_pub;
+    sensor_msgs::TimeReferencePtr trigger_info_msg; // reused like camera_info_msg, under the same mutex
+    ros::Publisher trigger_info_pub; // trigger sequence number and send time of each main image
+    Rectifier rectifier; // unconfigured unless the calibration loaded
+    Rectifier match_rectifier; // unconfigured unless EnableMatchImage() succeeded
+    std::function<bool()> match_wanted;
+    FrameTiming timing; // written by the transport thread
+    TimingDiagnostics diagnostics; // publishes timing once a second
+};
+
+#endif
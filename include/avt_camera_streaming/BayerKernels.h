@@ -0,0 +1,89 @@
+/*=========================================================
+Bilinear Bayer to RGB/BGR/mono kernels for the 8-bit Bayer
+formats, with SSSE3 and AVX2 versions picked at runtime.
+===========================================================*/
+
+#ifndef BAYERKERNELS
+#define BAYERKERNELS
+
+#include <cstddef>
+#include <cstdint>
+
+// PFNC naming as in VmbCommonTypes.h: BAYER_RG is VmbPixelFormatBayerRG8, its first line is R G R G ...
+enum BayerPattern
+{
+    BAYER_RG,
+    BAYER_BG,
+    BAYER_GB,
+    BAYER_GR,
+    NUM_BAYER_PATTERNS
+};
+
+// what the conversion stage writes, named after the ROS encodings
+enum OutputEncoding
+{
+    OUTPUT_RGB8,
+    OUTPUT_BGR8,
+    OUTPUT_MONO8,
+    OUTPUT_GREEN8,      // mono8 made of the interpolated green channel alone
+    NUM_OUTPUT_ENCODINGS
+};
+
+enum SimdLevel
+{
+    SIMD_NONE,
+    SIMD_SSSE3,
+    SIMD_AVX2
+};
+
+// BT.601 luma in 8.8 fixed point, the weights add up to 256
+static const int LUMA_R = 77;
+static const int LUMA_G = 150;
+static const int LUMA_B = 29;
+
+inline int OutputChannels(OutputEncoding encoding)
+{
+    return encoding == OUTPUT_MONO8 || encoding == OUTPUT_GREEN8 ? 1 : 3;
+}
+
+// Per-channel tables applied to the interpolated values, i.e. white balance gain and gamma
+// folded into one lookup. Built by ColorCorrection.
+struct ColorLut
+{
+    uint8_t r[256];
+    uint8_t g[256];
+    uint8_t b[256];
+};
+
+// Write output rows [y0, y1) from a width x height source frame. Full-resolution kernels have as
+// many output rows as the source, the preview kernels half as many.
+// Source rows outside the band are read as neighbours, so bands of one frame can run in parallel.
+// One function per (input, output) pair: pattern and channel order are compiled in.
+// lut is only read by the kernels selected with lut = true and must not be NULL for them.
+typedef void (*ConvertKernel)(const uint8_t *src, size_t src_step, int width, int height,
+                              uint8_t *dst, size_t dst_step, int y0, int y1, const ColorLut *lut);
+
+// Pixel by pixel with runtime pattern and encoding, written for clarity.
+// The specialized kernels must match it bit for bit. Borders are mirrored (reflect-101),
+// which keeps the Bayer phase, and interpolated values are rounded the same way everywhere:
+//   two neighbours (a + b + 1) >> 1, four neighbours (a + b + c + d + 2) >> 2,
+//   mono (LUMA_R * r + LUMA_G * g + LUMA_B * b + 128) >> 8, after the lut if there is one.
+void DebayerReference(const uint8_t *src, size_t src_step, int width, int height,
+                      uint8_t *dst, size_t dst_step, int y0, int y1, BayerPattern pattern, OutputEncoding encoding,
+                      const ColorLut *lut = NULL);
+
+// what this CPU supports
+SimdLevel DetectSimdLevel();
+const char *SimdLevelName(SimdLevel level);
+// the specialized kernel for one pair, using the fastest instruction set not above level.
+// lut: the variant that applies a ColorLut.
+ConvertKernel SelectBayerKernel(BayerPattern pattern, OutputEncoding encoding, SimdLevel level, bool lut = false);
+
+// Half-resolution preview: every 2x2 quad becomes one pixel, R and B as sampled and
+// G = (g1 + g2 + 1) >> 1. Output is (width / 2) x (height / 2), an odd last row or column is dropped.
+void PreviewReference(const uint8_t *src, size_t src_step, int width, int height,
+                      uint8_t *dst, size_t dst_step, int y0, int y1, BayerPattern pattern, OutputEncoding encoding,
+                      const ColorLut *lut = NULL);
+ConvertKernel SelectPreviewKernel(BayerPattern pattern, OutputEncoding encoding, SimdLevel level, bool lut = false);
+
+#endif
@@ -27,8 +27,27 @@ struct CameraParam
     //Todo remember own
     std::string ptp_mode;
     std::string camera_info_url_;
+    std::string frame_id;   // header.frame_id of the images and camera_info
     int binninghorizontal;
     int binningvertical;
+    bool publish_raw;       // publish the Bayer buffer, color only on demand
+    int debayer_threads;    // threads of the shared debayer pool, 0 = one per core
+    std::string output_encoding; // encoding of the converted image: rgb8, bgr8 or mono8
+    std::string mono_mode;  // mono topic: "quad" (2x2 luma, half resolution) or "green" (interpolated green, full resolution)
+    double gamma;           // output = input ^ (1 / gamma) in the conversion, 1 = off
+    int gamma_lut_bits;     // resolution of the gamma curve, 8 or 12
+    double wb_gain_red;     // white balance gains applied in the conversion, settable at runtime
+    double wb_gain_green;
+    double wb_gain_blue;
+    int num_frames;         // frame buffers announced to the camera, 0 = size automatically
+    int frame_queue_size;   // depth of the ring between the Vimba callback and the worker thread
+    int cpu;                // core the frame worker is pinned to, -1 = not pinned
+    int stream_bytes_per_second; // GigE bandwidth limit of the camera, 0 = camera setting
+    bool trigger_async;     // TriggerImage returns once the command is sent, not once the camera reports it done
+    int command_timeout_ms; // longest wait for a feature write or command to complete
+    int trigger_frame_timeout_ms; // a software trigger without a frame for this long was missed, 0 = from the frame period
+    int frame_arena_mb;     // frame buffers of all cameras of the process from one block this large, 0 = no arena
+    int output_buffers;     // output messages preallocated at startup, 0 = allocated as needed
 };
 
 
@@ -0,0 +1,50 @@
+/*=========================================================
+Cameras run together from one process: each has its own
+pipeline under its namespace, and one trigger topic plus
+the optional internal trigger generator fire all of them,
+paced by the slowest. avt_rig is this with any number of
+cameras, avt_stereo with two and pairing on top.
+===========================================================*/
+
+#ifndef CAMERARIG
+#define CAMERARIG
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "ros/ros.h"
+#include "avt_camera_streaming/AVTCamera.h"
+#include "avt_camera_streaming/TimingDiagnostics.h"
+#include "avt_camera_streaming/TriggerListener.h"
+#include "avt_camera_streaming/TriggerGenerator.h"
+
+class CameraRig
+{
+public:
+    // One AVTCamera per namespace: topics (image topic `topic`) in nh/<ns>/, parameters in
+    // private_nh/<ns>/. camera_triggers: also let <ns>/trigger fire just that camera.
+    // The common trigger is nh/trigger, the generator reads ~trigger_rate and friends.
+    CameraRig(ros::NodeHandle nh, ros::NodeHandle private_nh, const std::vector<std::string> &namespaces,
+              const std::string &topic = "avt_camera_img", bool camera_triggers = true);
+
+    void StartAcquisition();
+    void StopAcquisition();
+
+    size_t Size() const { return cameras.size(); }
+    AVTCamera &Camera(size_t i) { return *cameras[i]; }
+    const std::string &Namespace(size_t i) const { return namespaces[i]; }
+    // rig-wide timing on /diagnostics; what is added must outlive the rig
+    TimingDiagnostics &Diagnostics() { return diagnostics; }
+
+private:
+    // trigger (and every generator tick) fires every camera of the rig
+    void TriggerImages();
+
+    std::vector<std::string> namespaces;
+    std::vector<std::unique_ptr<AVTCamera> > cameras;
+    std::unique_ptr<TriggerListener> trigger; // stopped before the cameras go
+    std::unique_ptr<TriggerGenerator> generator; // idle without ~trigger_rate, also stopped before the cameras go
+    TimingDiagnostics diagnostics;
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*=========================================================
+ColorCorrection builds the white balance / gamma table
+that the conversion kernels apply while debayering.
+===========================================================*/
+
+#ifndef COLORCORRECTION
+#define COLORCORRECTION
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "avt_camera_streaming/BayerKernels.h"
+
+class ColorCorrection
+{
+public:
+    ColorCorrection();
+
+    // gamma: output = input ^ (1 / gamma), 1 is linear.
+    // lut_bits: 8 or 12, resolution of the gamma curve the gained values are looked up in.
+    // With 12 bits a gain does not merge neighbouring input levels before the curve.
+    void Configure(double gamma, int lut_bits);
+    // white balance gains, may be called from any thread while frames are converted
+    void SetGains(double red, double green, double blue);
+
+    // table for the next frame, empty while the correction is the identity.
+    // A frame keeps the table it started with; SetGains swaps in a new one.
+    std::shared_ptr<const ColorLut> Current() const { return std::atomic_load(&lut); }
+
+private:
+    // called with mutex held
+    void Rebuild();
+
+    std::mutex mutex;   // serializes Configure and SetGains
+    double gamma;
+    double gains[3];    // r, g, b
+    std::vector<uint8_t> curve; // gamma curve with 2^lut_bits entries
+    std::shared_ptr<const ColorLut> lut;
+};
+
+#endif
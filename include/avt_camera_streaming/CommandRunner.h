@@ -0,0 +1,108 @@
+/*=========================================================
+Runs Vimba commands and feature writes and waits for their
+completion with a timeout, polling IsCommandDone with an
+exponential backoff instead of spinning on it. Optionally
+the wait happens on a completion thread, so e.g. a trigger
+returns as soon as the command is sent. Keeps a latency
+histogram per command.
+===========================================================*/
+
+#ifndef COMMANDRUNNER
+#define COMMANDRUNNER
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "VimbaCPP/Include/VimbaCPP.h"
+#include "avt_camera_streaming/Histogram.h"
+
+struct CommandStats
+{
+    const char *name;
+    uint64_t completed;
+    uint64_t total_ns;      // summed latency, from the call until the camera reported done
+    uint64_t max_ns;
+    uint64_t timeouts;      // not done within the timeout, given up
+    uint64_t failures;      // the command or write itself failed
+};
+
+class CommandRunner
+{
+public:
+    // timeout_s bounds every wait for completion
+    explicit CommandRunner(double timeout_s = 0.5);
+    ~CommandRunner();
+
+    void SetTimeout(double timeout_s) { timeout_ns = (uint64_t)(timeout_s * 1e9); }
+
+    // Write a feature and wait until the camera is done with it. Writes that are no command
+    // (IsCommandDone fails for them) are done as soon as SetValue returns.
+    // name must be a string literal (or otherwise outlive the runner), it names the histogram.
+    template <typename T>
+    VmbErrorType SetValue(const AVT::VmbAPI::FeaturePtr &feature, const char *name, T value)
+    {
+        const uint64_t start_ns = NowNs();
+        Command &command = Find(name);
+        VmbErrorType err = feature->SetValue(value);
+        if (VmbErrorSuccess != err)
+        {
+            command.failures.fetch_add(1, std::memory_order_relaxed);
+            return err;
+        }
+        return Wait(feature, command, start_ns);
+    }
+    // Run a command and wait for it; VmbErrorTimeout if it is not done in time. Any other error
+    // means RunCommand itself failed and nothing was sent.
+    VmbErrorType Run(const AVT::VmbAPI::FeaturePtr &feature, const char *name);
+    // Run a command and return once it is sent; the completion thread waits for it and records
+    // its latency. If the next one is sent before the camera reported this one done, only the
+    // newer one is waited for and the older one counts as superseded.
+    VmbErrorType RunAsync(const AVT::VmbAPI::FeaturePtr &feature, const char *name);
+
+    // latency of one command, for the diagnostics; register before spinning starts
+    Histogram &Latency(const char *name) { return Find(name).latency; }
+
+    std::vector<CommandStats> GetStats() const;
+    void LogStats() const;
+
+private:
+    struct Command
+    {
+        explicit Command(const char *name) : name(name), completed(0), total_ns(0), max_ns(0), timeouts(0), failures(0) {}
+
+        const char *name;
+        Histogram latency;
+        std::atomic<uint64_t> completed;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint64_t> timeouts;
+        std::atomic<uint64_t> failures;
+    };
+
+    static uint64_t NowNs();
+    // the entry for name, made on first use
+    Command &Find(const char *name);
+    // poll until done, failed or timed out, and record the latency since start_ns
+    VmbErrorType Wait(const AVT::VmbAPI::FeaturePtr &feature, Command &command, uint64_t start_ns);
+    // completion thread
+    void Complete();
+
+    std::atomic<uint64_t> timeout_ns;
+    mutable std::mutex commands_mutex;
+    std::vector<std::unique_ptr<Command> > commands;    // a handful, found by name
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running;
+    AVT::VmbAPI::FeaturePtr pending;    // sent by RunAsync, not yet waited for
+    Command *pending_command;
+    uint64_t pending_start_ns;
+    std::atomic<uint64_t> superseded;
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,47 @@
+/*=========================================================
+ConversionTable maps a camera pixel format and an output
+encoding to the specialized conversion kernel.
+===========================================================*/
+
+#ifndef CONVERSIONTABLE
+#define CONVERSIONTABLE
+
+#include <string>
+#include "VimbaC/Include/VmbCommonTypes.h"
+#include "avt_camera_streaming/BayerKernels.h"
+
+// "rgb8", "bgr8" or "mono8"; false for anything else
+bool ParseOutputEncoding(const std::string &name, OutputEncoding &encoding);
+// the ROS encoding string of an output
+const char *EncodingName(OutputEncoding encoding);
+
+class ConversionTable
+{
+public:
+    // all kernels are resolved for one instruction set up front, Find is a plain lookup
+    explicit ConversionTable(SimdLevel level = DetectSimdLevel());
+
+    // NULL if frames in this format cannot be converted.
+    // lut: the variant that applies a ColorLut (white balance and gamma) while converting
+    ConvertKernel Find(VmbPixelFormatType format, OutputEncoding encoding, bool lut = false) const;
+    // half-resolution kernel, one output pixel per 2x2 block of the frame
+    ConvertKernel FindPreview(VmbPixelFormatType format, OutputEncoding encoding, bool lut = false) const;
+
+private:
+    enum Input
+    {
+        INPUT_BAYER_RG,
+        INPUT_BAYER_BG,
+        INPUT_BAYER_GB,
+        INPUT_BAYER_GR,
+        INPUT_MONO8,
+        NUM_INPUTS
+    };
+    // INPUT_* of a pixel format, NUM_INPUTS if it is not supported
+    static Input InputOf(VmbPixelFormatType format);
+
+    ConvertKernel kernels[NUM_INPUTS][NUM_OUTPUT_ENCODINGS][2];   // [..][..][with lut]
+    ConvertKernel previews[NUM_INPUTS][NUM_OUTPUT_ENCODINGS][2];
+};
+
+#endif
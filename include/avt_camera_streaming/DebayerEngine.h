@@ -0,0 +1,29 @@
+/*=========================================================
+DebayerEngine converts a Bayer frame in horizontal bands
+on the shared ThreadPool.
+===========================================================*/
+
+#ifndef DEBAYERENGINE
+#define DEBAYERENGINE
+
+#include "opencv2/core/core.hpp"
+#include "avt_camera_streaming/ThreadPool.h"
+#include "avt_camera_streaming/BayerKernels.h"
+
+class DebayerEngine
+{
+public:
+    explicit DebayerEngine(ThreadPool &pool = ThreadPool::Shared(), int bands_per_thread = 2);
+
+    // src: CV_8UC1 frame, dst: preallocated output (e.g. a message buffer) of the size and channel
+    // count the kernel writes. Kernels come from ConversionTable; bands are split over dst rows.
+    // Each band reads the rows around it straight from the frame, so bands need no halo copies.
+    // lut is handed to the kernel, required by the lut variants.
+    void Convert(const cv::Mat &src, cv::Mat &dst, ConvertKernel kernel, const ColorLut *lut = NULL);
+
+private:
+    ThreadPool &pool;
+    int bands_per_thread;
+};
+
+#endif
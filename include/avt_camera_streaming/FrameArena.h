@@ -0,0 +1,72 @@
+/*=========================================================
+One block of page-aligned memory, reserved at startup, that
+the frame pools of every camera in the process take their
+buffers from. Its size is a hard ceiling: a pool sizes
+itself to what still fits, and a camera that cannot get
+even the fewest buffers it needs does not start.
+===========================================================*/
+
+#ifndef FRAMEARENA
+#define FRAMEARENA
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+struct FrameArenaStats
+{
+    size_t ceiling;         // bytes reserved, 0 if there is no arena
+    size_t used;            // bytes handed out, in whole pages
+    size_t peak;
+    size_t blocks;          // buffers handed out
+    uint64_t refused;       // allocations that would have gone over the ceiling
+    bool locked;            // the pages are locked in RAM
+};
+
+class FrameArena
+{
+public:
+    // the process-wide arena
+    static FrameArena &Shared();
+
+    FrameArena();
+    ~FrameArena();
+
+    // Map ceiling bytes (rounded up to pages), touch every page and try to lock them in RAM, so
+    // the memory is resident from the start. Only the first call reserves; later ones (e.g. the
+    // other cameras of the process) are ignored. False if the memory could not be mapped.
+    bool Reserve(size_t ceiling);
+    bool Reserved() const { return base != NULL; }
+
+    // a page-aligned buffer of at least bytes, NULL if that would exceed the ceiling
+    unsigned char *Allocate(size_t bytes);
+    // how many buffers of bytes Allocate would hand out now, one after the other
+    size_t Fits(size_t bytes) const;
+    // give a buffer from Allocate back, NULL is ignored
+    void Free(unsigned char *buffer);
+
+    size_t PageSize() const { return page_size; }
+    FrameArenaStats GetStats() const;
+    void LogStats() const;
+
+private:
+    // a run of pages, in address order; neighbouring free blocks are merged
+    struct Block
+    {
+        size_t offset;
+        size_t size;
+        bool used;
+    };
+
+    FrameArena(const FrameArena &);
+    FrameArena &operator=(const FrameArena &);
+
+    mutable std::mutex mutex;
+    unsigned char *base;
+    size_t page_size;
+    std::vector<Block> blocks;
+    FrameArenaStats stats;
+};
+
+#endif
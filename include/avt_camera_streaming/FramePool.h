@@ -0,0 +1,153 @@
+/*=========================================================
+FramePool owns the frame buffers announced to the camera.
+It sizes itself from the measured processing time and
+records, per buffer, how long it spends in our code and how
+long in the capture queue. Delivered frames are handed out
+as FrameLease, which re-queues them exactly once.
+===========================================================*/
+
+#ifndef FRAMEPOOL
+#define FRAMEPOOL
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "VimbaCPP/Include/VimbaCPP.h"
+
+struct FrameBufferStats
+{
+    uint64_t deliveries;        // times the camera handed this buffer to us
+    uint64_t total_out_ns;      // summed time in user code, between delivery and re-queue
+    uint64_t max_out_ns;
+    uint64_t fills;             // re-queues followed by a delivery
+    uint64_t total_queued_ns;   // summed time in the capture queue, between re-queue and the next delivery
+    uint64_t min_queued_ns;     // 0 if never filled
+};
+
+struct FramePoolStats
+{
+    size_t depth;
+    uint64_t delivered;
+    uint64_t starvation_events;         // the camera was left without a queued buffer
+    uint64_t starved_ns;                // total time spent without a queued buffer
+    uint64_t frames_lost;               // gaps in the frame ID sequence
+    uint64_t frames_lost_while_starved; // gaps that opened while no buffer was queued
+    uint64_t duplicate_queues;          // re-queues of a buffer the camera already had, skipped
+    double mean_interval_s;             // mean time between deliveries, 0 if unknown
+    std::vector<FrameBufferStats> buffers;
+};
+
+class FramePool;
+
+// Owns a delivered frame from the callback until it goes back to the camera. Move-only.
+// The frame is re-queued by Requeue() or, at the latest, when the lease is destroyed,
+// so every path through the callback and the worker queues it exactly once.
+class FrameLease
+{
+public:
+    FrameLease() : pool(NULL) {}
+    FrameLease(FrameLease &&other);
+    FrameLease &operator=(FrameLease &&other);
+    ~FrameLease() { Requeue(); }
+
+    const AVT::VmbAPI::FramePtr &Frame() const { return frame; }
+    bool Valid() const { return pool != NULL; }
+    // steady clock (ns) when the camera handed the frame over, 0 for an empty lease
+    uint64_t DeliveredNs() const;
+    // give the buffer back now, e.g. as soon as its pixels are converted. No-op on an empty lease.
+    void Requeue();
+
+private:
+    friend class FramePool;
+    FrameLease(FramePool *pool, const AVT::VmbAPI::FramePtr &frame) : pool(pool), frame(frame) {}
+    FrameLease(const FrameLease &);
+    FrameLease &operator=(const FrameLease &);
+
+    FramePool *pool;
+    AVT::VmbAPI::FramePtr frame;
+};
+
+class FramePool
+{
+public:
+    static const size_t MIN_DEPTH = 2;
+    static const size_t MAX_DEPTH = 16;
+    static const size_t DEFAULT_DEPTH = 3;
+
+    FramePool();
+    ~FramePool();
+
+    // depth > 0 fixes the number of buffers, 0 sizes the pool from the previous acquisition
+    void SetRequestedDepth(int depth) { requested_depth = depth; }
+
+    // allocate, register and announce the buffers. Call before StartCapture(). The buffers come from
+    // FrameArena::Shared() if it is reserved: an automatic depth shrinks to what fits, down to
+    // MIN_DEPTH. False, with nothing announced, if fewer than that (or than num_frames) fit.
+    bool Announce(const AVT::VmbAPI::CameraPtr &pCamera, VmbInt64_t payload_size, const AVT::VmbAPI::IFrameObserverPtr &pObserver, double frame_rate);
+    // put every buffer into the capture queue. Call after StartCapture().
+    void QueueAll();
+    // unregister observers and give the buffers back to the arena. Call after RevokeAllFrames().
+    void Release();
+
+    // transport thread: the camera filled pFrame, take it over until the lease re-queues it
+    FrameLease Lease(const AVT::VmbAPI::FramePtr &pFrame);
+
+    // depth the pool would choose for the next acquisition
+    size_t SuggestDepth() const;
+    size_t Depth() const { return slots.size(); }
+    FramePoolStats GetStats() const;
+    void LogStats() const;
+    // warn (throttled) if the camera ran out of buffers since the last call. Worker thread only.
+    void CheckStarvation();
+
+private:
+    friend class FrameLease;
+
+    struct Slot
+    {
+        AVT::VmbAPI::FramePtr frame;
+        unsigned char *buffer;                  // in the arena, NULL without one (the frame allocated its own)
+        std::atomic<bool> out;                  // delivered and not yet re-queued
+        std::atomic<uint64_t> delivered_at_ns;
+        std::atomic<uint64_t> queued_at_ns;
+        std::atomic<uint64_t> deliveries;
+        std::atomic<uint64_t> total_out_ns;
+        std::atomic<uint64_t> max_out_ns;
+        std::atomic<uint64_t> fills;
+        std::atomic<uint64_t> total_queued_ns;
+        std::atomic<uint64_t> min_queued_ns;
+    };
+
+    void OnFrameDelivered(const AVT::VmbAPI::FramePtr &pFrame);
+    // hand pFrame back to the camera. Safe from the transport and the worker thread.
+    void Queue(const AVT::VmbAPI::FramePtr &pFrame);
+
+    Slot *FindSlot(const AVT::VmbAPI::FramePtr &pFrame);
+    void FreeBuffers();
+    void ResetCounters();
+
+    int requested_depth;
+    double frame_rate;
+    AVT::VmbAPI::CameraPtr camera;
+    std::vector<std::unique_ptr<Slot> > slots;   // fixed while capturing, so lookups need no lock
+
+    std::atomic<int> queued;                // buffers currently owned by the camera
+    std::atomic<uint64_t> delivered;
+    std::atomic<uint64_t> starvation_events;
+    std::atomic<uint64_t> starved_since_ns;
+    std::atomic<uint64_t> starved_ns;
+    std::atomic<uint64_t> frames_lost;
+    std::atomic<uint64_t> frames_lost_while_starved;
+    std::atomic<uint64_t> duplicate_queues;
+    std::atomic<uint64_t> first_delivery_ns;
+    std::atomic<uint64_t> last_delivery_ns;
+    uint64_t reported_starvation_events;
+
+    // only touched on the transport thread
+    bool have_frame_id;
+    VmbUint64_t last_frame_id;
+    bool starved_since_last_delivery;
+};
+
+#endif
@@ -0,0 +1,117 @@
+/*=========================================================
+Bounded single-producer/single-consumer frame ring.
+The Vimba transport thread pushes, one worker thread pops.
+===========================================================*/
+
+#ifndef FRAMEQUEUE
+#define FRAMEQUEUE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "VimbaCPP/Include/VimbaCPP.h"
+#include "avt_camera_streaming/FramePool.h"
+
+// snapshot of the ring counters, see FrameQueue::GetStats()
+struct FrameQueueStats
+{
+    uint64_t pushed;            // frames handed over by the callback
+    uint64_t popped;            // frames taken by the worker
+    uint64_t overruns;          // pushes rejected because the ring was full
+    size_t occupancy;           // frames currently waiting in the ring
+    size_t max_occupancy;       // high-water mark since construction
+    size_t capacity;
+};
+
+class FrameQueue
+{
+public:
+    explicit FrameQueue(size_t capacity) : slots(capacity + 1), head(0), tail(0), pushed(0), popped(0), overruns(0), max_occupancy(0)
+    {
+    }
+
+    // producer side. Never blocks; returns false (and counts an overrun) if the ring is full,
+    // in which case the caller keeps the lease. On success the lease is moved into the ring.
+    bool Push(FrameLease &lease)
+    {
+        const size_t t = tail.load(std::memory_order_relaxed);
+        const size_t next = Next(t);
+        if (next == head.load(std::memory_order_acquire))
+        {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        slots[t] = std::move(lease);
+        tail.store(next, std::memory_order_release);
+        pushed.fetch_add(1, std::memory_order_relaxed);
+
+        size_t occupancy = Size();
+        size_t seen = max_occupancy.load(std::memory_order_relaxed);
+        while (occupancy > seen && !max_occupancy.compare_exchange_weak(seen, occupancy, std::memory_order_relaxed))
+        {
+        }
+        return true;
+    }
+
+    // consumer side. Returns false if the ring is empty.
+    bool Pop(FrameLease &lease)
+    {
+        const size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        lease = std::move(slots[h]);    // leaves the slot empty, the ring does not hold on to the buffer
+        head.store(Next(h), std::memory_order_release);
+        popped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t Size() const
+    {
+        const size_t h = head.load(std::memory_order_acquire);
+        const size_t t = tail.load(std::memory_order_acquire);
+        return (t >= h) ? (t - h) : (t + slots.size() - h);
+    }
+
+    size_t Capacity() const
+    {
+        return slots.size() - 1;
+    }
+
+    FrameQueueStats GetStats() const
+    {
+        FrameQueueStats stats;
+        stats.pushed = pushed.load(std::memory_order_relaxed);
+        stats.popped = popped.load(std::memory_order_relaxed);
+        stats.overruns = overruns.load(std::memory_order_relaxed);
+        stats.occupancy = Size();
+        stats.max_occupancy = max_occupancy.load(std::memory_order_relaxed);
+        stats.capacity = Capacity();
+        return stats;
+    }
+
+private:
+    size_t Next(size_t i) const
+    {
+        return (i + 1 == slots.size()) ? 0 : i + 1;
+    }
+
+    // one slot is kept free to tell "full" from "empty"
+    std::vector<FrameLease> slots;
+    // head is only written by the consumer, tail only by the producer.
+    // Pad them onto separate cache lines so the two threads do not fight over one line.
+    // (padding rather than alignas: the ring lives on the heap and C++11 new ignores over-alignment)
+    char pad0[64];
+    std::atomic<size_t> head;
+    char pad1[64];
+    std::atomic<size_t> tail;
+    char pad2[64];
+    std::atomic<uint64_t> pushed;
+    std::atomic<uint64_t> popped;
+    std::atomic<uint64_t> overruns;
+    std::atomic<size_t> max_occupancy;
+};
+
+#endif
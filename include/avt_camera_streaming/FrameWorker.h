@@ -0,0 +1,66 @@
+/*=========================================================
+FrameWorker takes completed frames off the Vimba transport
+thread and processes them on a dedicated thread.
+===========================================================*/
+
+#ifndef FRAMEWORKER
+#define FRAMEWORKER
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <semaphore.h>
+#include "VimbaCPP/Include/VimbaCPP.h"
+#include "avt_camera_streaming/FrameQueue.h"
+
+// time the transport thread spends inside FrameObserver::FrameReceived
+struct CallbackStats
+{
+    uint64_t calls;
+    uint64_t total_ns;
+    uint64_t max_ns;
+};
+
+class FrameWorker
+{
+public:
+    // The handler runs on the worker thread. It may re-queue the frame early through the lease,
+    // otherwise that happens when the worker drops the lease after the handler returns.
+    typedef std::function<void(FrameLease&)> FrameHandler;
+
+    FrameWorker(size_t queue_size, const FrameHandler &handler);
+    ~FrameWorker();
+
+    // pin the worker thread to one core (-1: any), applied by Start()
+    void SetCpu(int cpu) { this->cpu = cpu; }
+    void Start();
+    // joins the worker. Frames still in the ring are re-queued (and flushed by the caller), call after EndCapture().
+    void Stop();
+
+    // Called from FrameObserver::FrameReceived on the transport thread. Never blocks.
+    // Returns false if the ring is full; the caller then still holds the lease, and the frame
+    // goes back to the camera when it is dropped.
+    bool Submit(FrameLease &lease);
+    void AddCallbackTime(uint64_t ns);
+
+    FrameQueueStats GetQueueStats() const { return queue.GetStats(); }
+    CallbackStats GetCallbackStats() const;
+    void LogStats() const;
+
+private:
+    void Run();
+
+    FrameQueue queue;
+    FrameHandler handler;
+    std::thread thread;
+    int cpu;
+    sem_t frames_available;
+    std::atomic<bool> running;
+
+    std::atomic<uint64_t> callback_calls;
+    std::atomic<uint64_t> callback_total_ns;
+    std::atomic<uint64_t> callback_max_ns;
+};
+
+#endif
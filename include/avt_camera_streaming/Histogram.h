@@ -0,0 +1,72 @@
+/*=========================================================
+Lock-free latency histogram. Writers on any thread add
+samples with relaxed atomics; one reader takes the counts
+of the last window, e.g. once per second for diagnostics.
+===========================================================*/
+
+#ifndef HISTOGRAM
+#define HISTOGRAM
+
+#include <atomic>
+#include <cstdint>
+
+// counts of one window, see Histogram::Take()
+struct HistogramSnapshot
+{
+    static const int BUCKETS = 120;
+
+    uint64_t buckets[BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+
+    double MeanNs() const { return count ? (double)sum_ns / count : 0.0; }
+    // upper edge of the bucket holding quantile q (0..1), at most max_ns. 0 if empty.
+    uint64_t PercentileNs(double q) const;
+};
+
+class Histogram
+{
+public:
+    static const int BUCKETS = HistogramSnapshot::BUCKETS;
+
+    Histogram();
+
+    // Log-linear buckets in microseconds, four per power of two (within 25 %), from 1 us
+    // to about 30 minutes. Anything larger lands in the last bucket.
+    void Add(uint64_t ns)
+    {
+        buckets[Bucket(ns / 1000)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        sum_ns.fetch_add(ns, std::memory_order_relaxed);
+        uint64_t seen = max_ns.load(std::memory_order_relaxed);
+        while (ns > seen && !max_ns.compare_exchange_weak(seen, ns, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // the samples since the previous Take(), and start a new window. One reader at a time.
+    HistogramSnapshot Take();
+
+    // lowest value in us that falls into bucket b
+    static uint64_t BucketStartUs(int b);
+
+private:
+    static int Bucket(uint64_t us)
+    {
+        if (us < 4)
+        {
+            return (int)us;
+        }
+        const int octave = 63 - __builtin_clzll(us);    // >= 2
+        const int b = (octave - 1) * 4 + (int)((us >> (octave - 2)) & 3);
+        return b < BUCKETS ? b : BUCKETS - 1;
+    }
+
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> max_ns;
+};
+
+#endif
@@ -3,7 +3,12 @@
     hui.xiao@uconn.edu
 ==============================================================*/
 
+#ifndef MESSAGEPUBLISHER
+#define MESSAGEPUBLISHER
+
+#include <atomic>
 #include <iostream>
+#include <vector>
 #include "ros/ros.h"
 #include "ros/console.h"
 #include "cv_bridge/cv_bridge.h"
@@ -12,24 +17,82 @@
 #include "opencv2/core/core.hpp"
 #include <opencv2/highgui/highgui.hpp>
 
+// allocation counters of the publish path
+struct PublishStats
+{
+    unsigned long long published;
+    unsigned long long messages_allocated;   // new sensor_msgs::Image objects
+    unsigned long long buffer_reallocations; // image data vectors that had to grow
+    unsigned long long bytes_copied;         // full-frame copies made while publishing
+    size_t recycled_messages;
+    size_t recycled_bytes;                   // data capacity held by the recycled messages
+};
+
+// topics published next to the main image topic
+enum ImageStream
+{
+    IMAGE_STREAM = 0,   // avt_camera_img: color, or the raw camera buffer in raw mode
+    COLOR_STREAM,       // avt_camera_img_color: color while in raw mode
+    PREVIEW_STREAM,     // avt_camera_img_preview: half resolution, one pixel per 2x2 Bayer block
+    MONO_STREAM,        // avt_camera_img_mono: mono8 straight from the Bayer mosaic
+    RECT_STREAM,        // avt_camera_img_rect: color, rectified with the camera_info calibration
+    NUM_IMAGE_STREAMS
+};
+
 class MessagePublisher
 {
 public:
+    // upper bound on recycled messages; beyond that a busy subscriber gets fresh allocations
+    static const size_t MAX_RECYCLED_MESSAGES = 8;
+
     // use member initializer list to initialize ImageTransport
     // Initializing when it is decleared will produce a compile error.
-    MessagePublisher() : it(nh)
+    // topic is resolved in the namespace of nh, i.e. the node's or the nodelet's
+    MessagePublisher(ros::NodeHandle node, const std::string &image_topic = "avt_camera_img") : nh(node), it(nh), topic(image_topic), max_recycled(MAX_RECYCLED_MESSAGES), published(0)
     {
-        img_pub = it.advertise("avt_camera_img",1);
+        img_pub = it.advertise(topic,1);
     }
 
+    // advertise one of the additional topics, named after the main topic
+    void Advertise(ImageStream stream);
+    // only worth computing a stream if somebody listens
+    bool HasSubscribers(ImageStream stream) const;
+
     // convert OpenCV image to ROS message
     // publish message to ROS topic
     void PublishImage(cv::Mat &image, unsigned long long); //without unsigned long long ts_cam;
 
+    // Zero-copy path: get a recycled message sized for the image, write the pixels straight
+    // into its data vector (e.g. through WrapImage) and hand it back to PublishImage.
+    // The message is published as a shared pointer: subscribers in the same process (nodelets)
+    // get this very object, and it is not written again until they have all released it.
+    sensor_msgs::ImagePtr AcquireImage(unsigned int height, unsigned int width, const std::string &encoding, unsigned int step);
+    // Make count recycled messages with bytes of data each now, with their pages touched, and recycle
+    // no more than that: the output buffers are then a fixed count * bytes, allocated before the first
+    // frame. A frame that finds all of them still held by subscribers gets a fresh message (counted in
+    // messages_allocated). Not while frames are being published.
+    void Preallocate(size_t count, size_t bytes);
+    // May be called from another thread than AcquireImage, e.g. by the stereo pairing stage.
+    void PublishImage(const sensor_msgs::ImagePtr &image, unsigned long long ts_cam, ImageStream stream = IMAGE_STREAM);
+    // cv::Mat header over the data of a message from AcquireImage, no copy
+    static cv::Mat WrapImage(const sensor_msgs::ImagePtr &image, int type);
+
+    PublishStats GetStats() const;
+    void LogStats() const;
+
 private:
-    // ros::init() is called in main.cpp
     ros::NodeHandle nh;
     image_transport::ImageTransport it;
     image_transport::Publisher img_pub;
+    std::string topic;
+    image_transport::Publisher stream_pub[NUM_IMAGE_STREAMS];   // IMAGE_STREAM is unused, that is img_pub
     sensor_msgs::ImagePtr msg;
-};
\ No newline at end of file
+    // messages we published earlier. One is reused once nobody else holds a reference to it,
+    // i.e. serialization is done and no intra-process subscriber kept it.
+    std::vector<sensor_msgs::ImagePtr> recycled;
+    size_t max_recycled;
+    PublishStats stats = PublishStats();    // published is counted in the atomic below
+    std::atomic<unsigned long long> published;
+};
+
+#endif
@@ -0,0 +1,30 @@
+/*=========================================================
+Mapping from Vimba pixel formats to ROS image encodings.
+===========================================================*/
+
+#ifndef PIXELFORMAT
+#define PIXELFORMAT
+
+#include "VimbaC/Include/VmbCommonTypes.h"
+
+// ROS encoding of the untouched camera buffer, NULL if the format is not supported
+inline const char *RawEncoding(VmbPixelFormatType format)
+{
+    switch (format)
+    {
+        case VmbPixelFormatBayerRG8: return "bayer_rggb8";
+        case VmbPixelFormatBayerBG8: return "bayer_bggr8";
+        case VmbPixelFormatBayerGB8: return "bayer_gbrg8";
+        case VmbPixelFormatBayerGR8: return "bayer_grbg8";
+        case VmbPixelFormatMono8:    return "mono8";
+        default:                     return NULL;
+    }
+}
+
+inline bool IsBayer8(VmbPixelFormatType format)
+{
+    return format == VmbPixelFormatBayerRG8 || format == VmbPixelFormatBayerBG8 ||
+           format == VmbPixelFormatBayerGB8 || format == VmbPixelFormatBayerGR8;
+}
+
+#endif
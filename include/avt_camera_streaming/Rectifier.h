@@ -0,0 +1,60 @@
+/*=========================================================
+Rectification from a camera_info calibration. The maps
+are computed once, in OpenCV's fixed-point form, and the
+remap runs in row bands on the shared ThreadPool.
+===========================================================*/
+
+#ifndef RECTIFIER
+#define RECTIFIER
+
+#include <vector>
+#include "opencv2/core/core.hpp"
+#include "sensor_msgs/CameraInfo.h"
+#include "avt_camera_streaming/ThreadPool.h"
+#include "avt_camera_streaming/BayerKernels.h"
+
+class Rectifier
+{
+public:
+    explicit Rectifier(ThreadPool &pool = ThreadPool::Shared(), int bands_per_thread = 2);
+
+    // build the maps for info (K, D, R, P at info.width x info.height). Returns false, and
+    // leaves the rectifier unconfigured, if the calibration is missing or not supported.
+    // The output can be cut to roi (in rectified pixels, empty = all) and shrunk by downscale,
+    // which costs nothing extra: the maps simply sample fewer, closer points.
+    bool Configure(const sensor_msgs::CameraInfo &info, int downscale = 1, const cv::Rect &roi = cv::Rect());
+    bool Configured() const { return !map_xy.empty(); }
+    // frames must have the calibrated size
+    bool Fits(int width, int height) const { return width == src_width && height == src_height; }
+    int Width() const { return map_xy.cols; }
+    int Height() const { return map_xy.rows; }
+    // 3x4 CV_64F projection matrix of the output, i.e. P with roi and downscale applied
+    const cv::Mat &Projection() const { return projection; }
+
+    // rectify an image that is already converted (any 8-bit channel count)
+    void Remap(const cv::Mat &src, cv::Mat &dst) const;
+    // Bayer frame to rectified image in one pass: each band converts only the source rows its
+    // part of the map touches, into a scratch buffer that stays in cache, and remaps from there.
+    // The full-size converted image is never written. kernel and lut as for DebayerEngine.
+    void ConvertRemap(const cv::Mat &bayer, cv::Mat &dst, ConvertKernel kernel, const ColorLut *lut);
+
+private:
+    struct Band
+    {
+        int y0, y1;             // output rows
+        int src_y0, src_y1;     // source rows the bilinear taps of these output rows read
+        cv::Mat map_xy;         // map_xy rows of the band with y relative to src_y0
+        cv::Mat scratch;        // converted source rows for ConvertRemap
+    };
+
+    ThreadPool &pool;
+    int bands_per_thread;
+    int src_width, src_height;
+    cv::Mat projection;
+    // integer source coordinates (CV_16SC2) and index into OpenCV's table of bilinear
+    // weights (CV_16UC1, INTER_BITS fractional bits per axis)
+    cv::Mat map_xy, map_w;
+    std::vector<Band> bands;
+};
+
+#endif
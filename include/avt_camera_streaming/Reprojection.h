@@ -0,0 +1,32 @@
+/*=========================================================
+Disparity to 3D points with the reprojection matrix Q of
+a rectified pair, with SSSE3 and AVX2 versions picked at
+runtime like the Bayer kernels.
+===========================================================*/
+
+#ifndef REPROJECTION
+#define REPROJECTION
+
+#include <cstddef>
+#include "opencv2/core/core.hpp"
+#include "avt_camera_streaming/BayerKernels.h"
+
+// Q (4x4, row major) of a rectified pair from the 3x4 projection matrices of its left and right
+// images, as cv::stereoRectify would give it: (X, Y, Z, W) = Q (u, v, d, 1).
+void ReprojectionMatrix(const cv::Mat &left, const cv::Mat &right, float q[16]);
+
+// Points of one disparity row, for the pixels (u0 + i * du, v), i < count, whose disparities
+// disparity[i] are stored one after the other. A pixel is a point if its disparity is at least
+// min_disparity (so StereoBM's invalid marker and NaN drop out) and W > 0 (in front of the camera).
+// Points are written packed, x y z float each, and their number is returned; xyz must have room
+// for 3 * count floats.
+typedef size_t (*ReprojectKernel)(const float *disparity, size_t count, float u0, float du, float v,
+                                  const float q[16], float min_disparity, float *xyz);
+
+// Plain C++, the vector versions must match it bit for bit
+size_t ReprojectReference(const float *disparity, size_t count, float u0, float du, float v,
+                          const float q[16], float min_disparity, float *xyz);
+// the fastest version not above level
+ReprojectKernel SelectReprojectKernel(SimdLevel level);
+
+#endif
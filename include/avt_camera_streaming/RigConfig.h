@@ -0,0 +1,22 @@
+/*=========================================================
+A camera rig described in one YAML file, loaded into the
+node's private namespace with <rosparam command="load">:
+  defaults: {param: value, ...}       applied to every camera
+  cameras:  [{namespace: cam_1, cam_IP: ..., ...}, ...]
+See config/rig.yaml.
+===========================================================*/
+
+#ifndef RIGCONFIG
+#define RIGCONFIG
+
+#include <string>
+#include <vector>
+#include "ros/ros.h"
+
+// Copies ~defaults and then the entry of each camera in ~cameras to ~<namespace>/, where
+// AVTCamera reads its parameters, so one camera's entry overrides the defaults.
+// Returns the namespaces in list order; empty if ~cameras is not set or not a list.
+// Entries without a namespace are skipped with an error.
+std::vector<std::string> LoadRigConfig(ros::NodeHandle &private_nh);
+
+#endif
@@ -0,0 +1,116 @@
+/*=========================================================
+Block matching on the rectified match images of a stereo
+pair, in overlapping row bands on the shared ThreadPool.
+Publishes stereo_msgs/DisparityImage, and optionally the
+points as sensor_msgs/PointCloud2.
+===========================================================*/
+
+#ifndef STEREODISPARITY
+#define STEREODISPARITY
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ros/ros.h"
+#include "opencv2/core/core.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "sensor_msgs/Image.h"
+#include "sensor_msgs/PointCloud2.h"
+#include "stereo_msgs/DisparityImage.h"
+#include "avt_camera_streaming/ThreadPool.h"
+#include "avt_camera_streaming/Histogram.h"
+#include "avt_camera_streaming/Reprojection.h"
+
+// cv::StereoBM settings
+struct DisparityParams
+{
+    int min_disparity;
+    int num_disparities;    // multiple of 16
+    int block_size;         // odd, 5..255
+    int texture_threshold;
+    int uniqueness_ratio;
+    int speckle_window_size; // 0 = no speckle filter
+    int speckle_range;
+};
+
+struct DisparityStats
+{
+    uint64_t matched;
+    uint64_t dropped;       // pairs replaced by a newer one before they were matched
+};
+
+class StereoDisparity
+{
+public:
+    // left and right are the 3x4 projection matrices of the match images
+    // (Rectifier::Projection()), for the focal length, the baseline and Q.
+    // cloud_stride > 0 also publishes points2 from every cloud_stride-th row and column.
+    StereoDisparity(ros::NodeHandle nh, const DisparityParams &params, const cv::Mat &left, const cv::Mat &right, int cloud_stride = 0, ThreadPool &pool = ThreadPool::Shared());
+    ~StereoDisparity();
+
+    void Start();
+    void Stop();
+
+    // the cameras only make match images while somebody listens
+    bool HasSubscribers() const { return pub.getNumSubscribers() > 0 || cloud_pub.getNumSubscribers() > 0; }
+    // a matched pair of mono8 match images, from a camera worker thread. Never blocks: the
+    // matcher thread takes the latest pair, one that waits when the next arrives is dropped.
+    // The disparity goes out in the left image's header.frame_id, its rectified camera frame.
+    void Submit(const sensor_msgs::ImagePtr &left, const sensor_msgs::ImagePtr &right, unsigned long long ts_cam);
+
+    DisparityStats GetStats() const;
+    void LogStats() const;
+
+    // time to match one pair and to make its cloud, for the diagnostics
+    Histogram match_time;
+    Histogram cloud_time;
+
+private:
+    struct Band
+    {
+        int y0, y1;                 // disparity rows the band owns
+        int src_y0, src_y1;         // rows it matches, y0..y1 plus the block's reach
+        cv::Ptr<cv::StereoBM> matcher;  // one per band, the matcher keeps state
+        cv::Mat disparity;          // CV_16S, 4 fractional bits
+    };
+
+    void Run();
+    // disparity of one pair into msg, in the left camera's frame_id
+    void Match(const cv::Mat &left, const cv::Mat &right, unsigned long long ts_cam, const std::string &frame_id);
+    void Prepare(int width, int height);
+    // points of the disparity image (32FC1, the one in msg) into cloud, in frame_id: the rectified
+    // left camera's frame, which the points are reprojected into
+    void PublishCloud(const cv::Mat &image, const std::string &frame_id);
+
+    ros::Publisher pub;
+    DisparityParams params;
+    double focal;       // of the match images, in pixels
+    double baseline;    // in the units of the calibration
+    ThreadPool &pool;
+
+    std::vector<Band> bands;
+    cv::Mat disparity;  // CV_16S, whole image, for the speckle filter
+    cv::Mat speckle_buffer; // the filter's scratch, kept from pair to pair
+    int width, height;  // of the match images the bands were made for
+    stereo_msgs::DisparityImagePtr msg; // reused once subscribers released it
+
+    ros::Publisher cloud_pub;
+    int cloud_stride;   // 0 = no cloud
+    float q[16];        // reprojection matrix of the match images
+    ReprojectKernel reproject;
+    std::vector<float> gathered;            // disparities of the strided columns of one row
+    sensor_msgs::PointCloud2Ptr cloud;      // reused like msg, its data keeps the capacity for a full cloud
+
+    std::thread thread;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool running;
+    sensor_msgs::ImagePtr waiting[2];
+    unsigned long long waiting_ts;
+    DisparityStats stats;
+};
+
+#endif
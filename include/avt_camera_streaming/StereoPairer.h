@@ -0,0 +1,77 @@
+/*=========================================================
+Matches the frames of the two stereo cameras by their
+hardware (PTP) timestamp and publishes complete pairs only,
+both images with the same header stamp.
+===========================================================*/
+
+#ifndef STEREOPAIRER
+#define STEREOPAIRER
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "sensor_msgs/Image.h"
+#include "avt_camera_streaming/Histogram.h"
+
+struct StereoPairStats
+{
+    uint64_t pairs;
+    uint64_t orphans[2];        // frames of one side dropped without a partner
+    uint64_t total_skew_ns;     // summed |left - right| over the pairs
+    uint64_t max_skew_ns;
+};
+
+class StereoPairer
+{
+public:
+    enum Side
+    {
+        LEFT = 0,
+        RIGHT = 1
+    };
+
+    // publishes one image of a pair; ts_cam is the common stamp
+    typedef std::function<void(const sensor_msgs::ImagePtr&, unsigned long long ts_cam)> Publisher;
+    // gets the match images of a pair, e.g. the disparity stage
+    typedef std::function<void(const sensor_msgs::ImagePtr &left, const sensor_msgs::ImagePtr &right, unsigned long long ts_cam)> PairHandler;
+
+    // frames further apart than tolerance_ns are not a pair
+    StereoPairer(uint64_t tolerance_ns, const Publisher &left, const Publisher &right);
+    // set before the first Add()
+    void SetPairHandler(const PairHandler &handler) { pair_handler = handler; }
+
+    // a frame of one camera, from that camera's worker thread, with its match image (may be NULL).
+    // Timestamps of one side must not go backwards. The pair is published, and the match images
+    // handed on if both sides have one, from the thread that completes it.
+    void Add(Side side, const sensor_msgs::ImagePtr &image, const sensor_msgs::ImagePtr &match, unsigned long long ts_cam);
+
+    StereoPairStats GetStats() const;
+    void LogStats() const;
+
+    // |left - right| of every pair, for the diagnostics
+    Histogram skew;
+
+private:
+    struct Pending
+    {
+        sensor_msgs::ImagePtr image;
+        sensor_msgs::ImagePtr match;
+        unsigned long long ts_cam;
+    };
+
+    // frames held per side while the other camera catches up; beyond that the oldest is an orphan
+    static const size_t MAX_PENDING = 4;
+    // orphans in a row, without a pair in between, before the timestamps are taken to never match
+    static const uint64_t ORPHANS_BEFORE_ERROR = 20;
+
+    uint64_t tolerance_ns;
+    Publisher publishers[2];
+    PairHandler pair_handler;
+    mutable std::mutex mutex;
+    std::vector<Pending> pending[2];   // oldest first, never more than MAX_PENDING + 1 so it never reallocates
+    StereoPairStats stats;
+    uint64_t orphans_since_pair;
+};
+
+#endif
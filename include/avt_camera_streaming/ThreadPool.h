@@ -0,0 +1,83 @@
+/*=========================================================
+Persistent worker threads shared by every camera pipeline
+in the process. Used to split per-frame work into bands.
+===========================================================*/
+
+#ifndef THREADPOOL
+#define THREADPOOL
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+    // the process-wide pool
+    static ThreadPool &Shared();
+
+    // threads = 0 uses one thread per core. The calling thread of ParallelFor
+    // always helps, so n threads means n - 1 pool workers.
+    explicit ThreadPool(int threads = 0);
+    ~ThreadPool();
+
+    // Size the pool, once per process: the first call restarts it with threads (0 = one per core),
+    // later calls change nothing and only succeed if they ask for the same number. Also refuses
+    // while a ParallelFor is running. False if the pool keeps a different size.
+    bool Configure(int threads);
+    int ThreadCount() const { return (int)workers.size() + 1; }
+
+    // run task(0) .. task(count - 1) on the pool and the calling thread, return when all are done.
+    // Several callers (e.g. one per camera) may run jobs at the same time; they share the workers.
+    // task is called through a plain pointer, not wrapped in a std::function, and the job object
+    // is recycled, so a call does not allocate.
+    template <typename Task>
+    void ParallelFor(size_t count, const Task &task)
+    {
+        ParallelFor(count, &Invoke<Task>, &task);
+    }
+
+private:
+    typedef void (*TaskCall)(const void *task, size_t i);
+
+    template <typename Task>
+    static void Invoke(const void *task, size_t i)
+    {
+        (*static_cast<const Task*>(task))(i);
+    }
+
+    struct Job
+    {
+        TaskCall call;
+        const void *task;
+        size_t count;
+        std::atomic<size_t> next;
+        std::atomic<size_t> done;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+
+    void ParallelFor(size_t count, TaskCall call, const void *task);
+    // 0 and below: one per core
+    static int Resolve(int threads);
+    void Start(int threads);
+    void Stop();
+    void Run();
+    // claim and run indices of job until none are left
+    static void Work(Job &job);
+
+    std::vector<std::thread> workers;
+    std::vector<std::shared_ptr<Job> > jobs;  // capacity reserved up front, a deque would allocate as it moves
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::mutex configure_mutex;
+    bool configured;
+    std::atomic<int> callers;   // ParallelFor calls in progress
+};
+
+#endif
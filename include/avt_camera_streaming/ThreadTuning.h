@@ -0,0 +1,18 @@
+/*=========================================================
+Pinning and real-time scheduling for the driver's own
+threads: the frame worker, the trigger listener and the
+trigger generator.
+===========================================================*/
+
+#ifndef THREADTUNING
+#define THREADTUNING
+
+#include <thread>
+
+// pin thread to one core; false if that failed. cpu < 0 leaves it alone and succeeds.
+bool PinThread(std::thread &thread, int cpu);
+// run thread with SCHED_FIFO at priority; false without CAP_SYS_NICE or an rtprio limit.
+// priority <= 0 keeps normal scheduling and succeeds.
+bool SetFifoPriority(std::thread &thread, int priority);
+
+#endif
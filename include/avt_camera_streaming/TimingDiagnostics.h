@@ -0,0 +1,55 @@
+/*=========================================================
+Frame timing histograms, published once a second on
+/diagnostics: frame interval and jitter, host receive
+delay, stereo skew.
+===========================================================*/
+
+#ifndef TIMINGDIAGNOSTICS
+#define TIMINGDIAGNOSTICS
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "ros/ros.h"
+#include "avt_camera_streaming/Histogram.h"
+
+// timing of one camera's frames, fed from its Vimba transport thread
+class FrameTiming
+{
+public:
+    FrameTiming() : last_ts(0), last_interval(0) {}
+
+    // ts_cam from Frame::GetTimestamp, host_ns the host clock when the frame arrived.
+    // Called by one thread at a time.
+    void OnFrame(uint64_t ts_cam, uint64_t host_ns);
+
+    Histogram interval;         // between consecutive camera timestamps
+    Histogram jitter;           // |interval - previous interval|
+    Histogram receive_delay;    // host arrival - camera timestamp; needs the camera on PTP with the host clock
+
+private:
+    uint64_t last_ts;
+    uint64_t last_interval;
+};
+
+class TimingDiagnostics
+{
+public:
+    // name identifies the status in the DiagnosticArray, e.g. the camera namespace
+    TimingDiagnostics(ros::NodeHandle nh, const std::string &name);
+
+    // register before spinning starts; the histogram must outlive this object
+    void Add(const std::string &label, Histogram &histogram);
+    void Add(FrameTiming &timing);
+
+private:
+    void timerCb(const ros::TimerEvent &event);
+
+    std::string name;
+    ros::Publisher pub;
+    ros::Timer timer;
+    std::vector<std::pair<std::string, Histogram*> > histograms;
+};
+
+#endif
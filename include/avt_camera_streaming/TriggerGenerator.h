@@ -0,0 +1,76 @@
+/*=========================================================
+Triggers from inside the driver instead of from a trigger
+topic: a thread sleeps on clock_nanosleep to absolute ticks
+of the system clock, at a fixed rate and phase, and fires
+the handler (TriggerSoftware on the cameras) on each tick.
+Records how late each tick fired and how far the intervals
+strayed from the period.
+===========================================================*/
+
+#ifndef TRIGGERGENERATOR
+#define TRIGGERGENERATOR
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include "ros/ros.h"
+#include "avt_camera_streaming/Histogram.h"
+
+struct TriggerGeneratorStats
+{
+    uint64_t fired;
+    uint64_t skipped;       // ticks not fired because the thread woke after the next one was due
+    uint64_t held_back;     // ticks fired but not sent, faster than the cameras can take frames
+    uint64_t max_late_ns;   // longest delay from a tick to the handler starting
+    double achieved_rate;   // fires per second between the first and the last, 0 with fewer than two
+};
+
+class TriggerGenerator
+{
+public:
+    // false if the trigger was held back (rejected or deferred by the TriggerGovernor)
+    typedef std::function<bool()> Handler;
+
+    // Reads ~trigger_rate (Hz, 0 = no generator), ~trigger_phase_ms (offset of the ticks from
+    // the system clock's multiples of the period), ~trigger_generator_priority (SCHED_FIFO,
+    // 0 = normal scheduling) and ~trigger_generator_cpu (-1 = any core) from private_nh.
+    TriggerGenerator(ros::NodeHandle private_nh, const Handler &handler);
+    ~TriggerGenerator();
+
+    bool Enabled() const { return period_ns > 0; }
+    double Rate() const { return period_ns ? 1e9 / period_ns : 0.0; }
+    // fire from the next tick on; no-op if not enabled
+    void Start();
+    void Stop();
+
+    TriggerGeneratorStats GetStats() const;
+    // after Stop()
+    void LogStats() const;
+
+    Histogram late;         // tick due -> handler starts
+    Histogram deviation;    // |interval between two fires - period|
+
+private:
+    void Run();
+    // sleep until the absolute system clock time due_ns, waking at least every 100 ms to see Stop()
+    void SleepUntil(uint64_t due_ns);
+
+    Handler handler;
+    uint64_t period_ns;
+    uint64_t phase_ns;
+    int priority;
+    int cpu;
+    std::atomic<bool> running;
+    std::thread thread;
+
+    // written by the generator thread
+    std::atomic<uint64_t> fired;
+    std::atomic<uint64_t> skipped;
+    std::atomic<uint64_t> held_back;
+    std::atomic<uint64_t> max_late_ns;
+    std::atomic<uint64_t> first_fire_ns;
+    std::atomic<uint64_t> last_fire_ns;
+};
+
+#endif
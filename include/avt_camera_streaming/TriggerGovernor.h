@@ -0,0 +1,75 @@
+/*=========================================================
+Keeps triggers at or below the rate the camera can take
+frames, given by its exposure and frame rate limits. A
+trigger that comes too early is rejected, or coalesced
+with the other early ones into one trigger sent as soon as
+the camera is ready again; either way it is counted.
+===========================================================*/
+
+#ifndef TRIGGERGOVERNOR
+#define TRIGGERGOVERNOR
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+enum GovernorMode
+{
+    GOVERNOR_OFF,       // send every trigger, only count the early ones
+    GOVERNOR_REJECT,    // drop early triggers, like the camera would, but counted
+    GOVERNOR_COALESCE   // send one trigger for all early ones, when the camera is ready
+};
+
+// "off", "reject" or "coalesce"; false for anything else
+bool ParseGovernorMode(const std::string &name, GovernorMode &mode);
+const char *GovernorModeName(GovernorMode mode);
+
+struct TriggerGovernorStats
+{
+    uint64_t received;      // triggers asked for
+    uint64_t sent;          // triggers that went to the camera, at once or deferred
+    uint64_t early;         // asked for less than the minimum period after the last one sent
+    uint64_t rejected;      // early and dropped
+    uint64_t coalesced;     // early and merged into a deferred trigger
+};
+
+class TriggerGovernor
+{
+public:
+    enum Decision
+    {
+        SEND,       // send it now
+        DEFER,      // coalesced: send at DueNs()
+        REJECT      // drop it
+    };
+
+    TriggerGovernor();
+
+    void SetMode(GovernorMode mode);
+    GovernorMode Mode() const { return mode; }
+    // the shortest time between two frames the camera can take, 0 = unknown (nothing is early)
+    void SetMinPeriod(double period_s);
+    double MinPeriod() const;
+
+    // A trigger is asked for at now_ns (steady clock). Call Sent() after sending it on SEND.
+    Decision OnTrigger(uint64_t now_ns);
+    // a trigger went to the camera at now_ns
+    void Sent(uint64_t now_ns);
+    // a coalesced trigger is waiting; it is due at DueNs()
+    bool Deferred() const;
+    uint64_t DueNs() const;
+
+    TriggerGovernorStats GetStats() const;
+    void LogStats() const;
+
+private:
+    mutable std::mutex mutex;
+    GovernorMode mode;
+    uint64_t min_period_ns;
+    bool have_sent;
+    uint64_t last_sent_ns;
+    bool deferred;
+    TriggerGovernorStats stats;
+};
+
+#endif
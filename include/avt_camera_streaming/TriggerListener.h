@@ -0,0 +1,66 @@
+/*=========================================================
+The trigger topic on its own callback queue, served by its
+own thread as soon as a message arrives, instead of by the
+node's spin loop. Measures how long a trigger takes from
+roscpp receiving it to the handler having run. Triggers
+that come faster than the camera can take frames are held
+back by a TriggerGovernor.
+===========================================================*/
+
+#ifndef TRIGGERLISTENER
+#define TRIGGERLISTENER
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "ros/ros.h"
+#include "ros/callback_queue.h"
+#include "std_msgs/String.h"
+#include "avt_camera_streaming/Histogram.h"
+#include "avt_camera_streaming/TriggerGovernor.h"
+
+class TriggerListener
+{
+public:
+    typedef std::function<void()> Handler;
+
+    // Subscribes to topic in nh's namespace, with TCP_NODELAY, and calls handler for every message
+    // on a dedicated thread. ~trigger_priority (SCHED_FIFO priority, 0 = normal scheduling) and
+    // ~trigger_cpu (-1 = any core) are read from private_nh, and ~trigger_governor (off, reject or
+    // coalesce) for the triggers that come too early, see TriggerGovernor.h.
+    TriggerListener(ros::NodeHandle nh, ros::NodeHandle private_nh, const Handler &handler, const std::string &topic = "trigger");
+    ~TriggerListener();
+
+    // the shortest frame period of the camera(s) the handler triggers, once acquiring; also published
+    // as the highest trigger rate on trigger_rate_limit next to the trigger topic
+    void SetMinPeriod(double period_s);
+    void LogStats() const { governor.LogStats(); }
+    // A trigger from another source (the TriggerGenerator), governed together with the topic's so
+    // the two never come closer than the minimum period. False if it was rejected or deferred.
+    bool Fire();
+
+    Histogram dispatch; // roscpp received the message -> handler starts
+    Histogram latency;  // roscpp received the message -> handler returned, e.g. TriggerSoftware sent
+
+private:
+    void triggerCb(const ros::MessageEvent<std_msgs::String const> &event);
+    void Run();
+    // ask the governor, and send if it says so. Locked.
+    TriggerGovernor::Decision Govern(uint64_t now_ns);
+
+    Handler handler;
+    int priority;
+    int cpu;
+    TriggerGovernor governor;
+    std::mutex fire_mutex;  // the topic thread and the generator: decide and send as one step
+    ros::CallbackQueue queue;
+    ros::Subscriber sub;
+    ros::Publisher rate_pub;
+    std::atomic<bool> running;
+    std::thread thread;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*=========================================================
+Numbers the software triggers of one camera and matches the
+delivered frames to them in order, so every image can name
+the trigger that made it. Frame ID gaps (frames lost on the
+way) use up their triggers; a trigger sent too long before
+a frame for it to be that frame's, or without a frame for
+too long, was missed by the camera.
+===========================================================*/
+
+#ifndef TRIGGERTRACKER
+#define TRIGGERTRACKER
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "ros/ros.h"
+#include "avt_camera_streaming/Histogram.h"
+
+struct TriggerStats
+{
+    uint64_t triggers;      // TriggerSoftware sent
+    uint64_t matched;       // frames delivered for a trigger
+    uint64_t missed;        // triggers without a frame within the timeout, or pushed out by newer ones
+    uint64_t frames_lost;   // triggers whose frame was taken but lost (a gap in the frame IDs)
+    uint64_t untriggered;   // frames with no trigger waiting for them
+};
+
+class TriggerTracker
+{
+public:
+    // triggers waiting for their frame, and triggers remembered for TriggerStamp()
+    static const size_t CAPACITY = 64;
+
+    TriggerTracker();
+
+    // a trigger older than this without a frame was missed
+    void SetTimeout(double timeout_s) { timeout_ns = (uint64_t)(timeout_s * 1e9); }
+    // The camera's shortest frame period, 0 = unknown. A frame cannot be for a trigger sent more than
+    // this plus the shortest trigger-to-frame latency seen before it, if a later trigger can be its own.
+    void SetMinPeriod(double period_s) { min_period_ns = period_s > 0 ? (uint64_t)(period_s * 1e9) : 0; }
+    // forget the waiting triggers, the counts and the latency seen, before an acquisition starts
+    void Reset();
+
+    // Trigger thread: TriggerSoftware went out at sent_ns (steady clock), stamp is the ROS time of it.
+    // Returns the trigger's sequence number; they count up from 1.
+    uint32_t OnTrigger(uint64_t sent_ns, const ros::Time &stamp);
+    // the trigger was not sent after all (not for a timeout waiting on a sent one): forget it,
+    // unless a frame already took it
+    void Withdraw(uint32_t seq);
+    // Worker thread, frames in delivery order: the sequence number of the trigger that made the frame,
+    // 0 if there is none. delivered_ns is the steady clock when the camera handed the frame over.
+    uint32_t OnFrame(bool frame_id_valid, uint64_t frame_id, uint64_t delivered_ns);
+    // ROS time at which trigger seq went out, false if it is no longer remembered
+    bool TriggerStamp(uint32_t seq, ros::Time &stamp) const;
+
+    TriggerStats GetStats() const;
+    void LogStats() const;
+    // warn (throttled) about triggers missed since the last call. Worker thread only.
+    void CheckMissed();
+
+    // trigger sent -> frame delivered to the host
+    Histogram latency;
+
+private:
+    struct Trigger
+    {
+        uint32_t seq;
+        uint64_t sent_ns;
+    };
+    struct Stamp
+    {
+        uint32_t seq;
+        ros::Time stamp;
+    };
+
+    // drop waiting triggers sent before now - timeout. Locked.
+    void Expire(uint64_t now_ns);
+    // drop waiting triggers too old for a frame delivered at delivered_ns. Locked.
+    void SkipIgnored(uint64_t delivered_ns);
+    const Trigger &Waiting(size_t i) const { return waiting[(waiting_first + i) % CAPACITY]; }
+    void PopWaiting() { waiting_first = (waiting_first + 1) % CAPACITY; waiting_count--; }
+
+    mutable std::mutex mutex;
+    uint64_t timeout_ns;
+    uint64_t min_period_ns;
+    uint64_t latency_floor_ns;  // shortest trigger-to-frame latency matched so far, 0 = none yet
+    uint32_t next_seq;
+    // triggers waiting for their frame, oldest first from waiting_first
+    Trigger waiting[CAPACITY];
+    size_t waiting_first;
+    size_t waiting_count;
+    // the last CAPACITY triggers, by seq % CAPACITY, for TriggerStamp()
+    Stamp stamps[CAPACITY];
+    bool have_frame_id;
+    uint64_t last_frame_id;
+    TriggerStats stats;
+    uint64_t reported_missed;
+};
+
+#endif
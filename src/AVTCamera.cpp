@@ -0,0 +1,1122 @@
+/*=========================================================
+Created by Hui Xiao - University of Connecticuit - 2019
+hui.xiao@uconn.edu
+===========================================================*/
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include "ros/console.h"
+#include "string.h"
+#include "Common/StreamSystemInfo.h"
+#include "Common/ErrorCodeToMessage.h"
+#include "avt_camera_streaming/AVTCamera.h"
+#include "avt_camera_streaming/PixelFormat.h"
+#include "avt_camera_streaming/FrameArena.h"
+
+/*From Vimba C++ manual: To assure correct continuous image capture, use at least two or three frames. The appropriate number of frames to be queued in your application depends on the frames per second the camera 
+delivers and on the speed with which you are able to re-queue frames (also taking into consideration the 
+operating system load). The image frames are filled in the same order in which they were queued.
+The number of frames is set by the ~num_frames param, or chosen by FramePool from the measured re-queue time.*/
+
+// VimbaSystem is a process-wide singleton. It is started by the first camera and shut down with
+// the last one, so the cameras of a rig (avt_stereo, nodelets in one manager) share one transport layer.
+static std::mutex vimba_mutex;
+static int vimba_users = 0;
+
+static void StartupVimba(AVT::VmbAPI::VimbaSystem &sys)
+{
+    std::lock_guard<std::mutex> lock(vimba_mutex);
+    if (vimba_users++ == 0)
+    {
+        sys.Startup();
+    }
+}
+
+static void ShutdownVimba(AVT::VmbAPI::VimbaSystem &sys)
+{
+    std::lock_guard<std::mutex> lock(vimba_mutex);
+    if (--vimba_users == 0)
+    {
+        sys.Shutdown();
+    }
+}
+
+//define observer that reacts on new frames
+class FrameObserver : public AVT::VmbAPI::IFrameObserver
+{
+public:
+    // In contructor call the constructor of the base class
+    // and pass a camera object
+    FrameObserver( AVT::VmbAPI::CameraPtr pCamera, FrameWorker& worker, FramePool& pool, FrameTiming& timing) : IFrameObserver( pCamera ), pWorker(&worker), pPool(&pool), pTiming(&timing)
+    {
+        
+    }
+    // runs on the Vimba transport thread: hand the frame over and return as fast as possible.
+    // Conversion, publishing and re-queueing happen in AVTCamera::ProcessFrame on the worker thread.
+    void FrameReceived( const AVT::VmbAPI::FramePtr pFrame )
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        VmbUint64_t ts_cam;
+        if (VmbErrorSuccess == pFrame->GetTimestamp(ts_cam))
+        {
+            // a few relaxed atomic adds, read once a second by the diagnostics timer
+            pTiming->OnFrame(ts_cam, ros::Time::now().toNSec());
+        }
+        {
+            FrameLease lease = pPool->Lease(pFrame);
+            // if the worker is behind, the lease stays here and gives the buffer straight back to the camera
+            pWorker->Submit(lease);
+        }
+        pWorker->AddCallbackTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+    }
+private:
+    FrameWorker *pWorker;  // class pointer, will point to the FrameWorker of the AVTCamera when initializing
+    FramePool *pPool;      // hands out the leases that re-queue the frames
+    FrameTiming *pTiming;  // interval, jitter and receive delay histograms
+};
+
+AVTCamera::AVTCamera(ros::NodeHandle nh, ros::NodeHandle private_nh, const std::string &topic, bool subscribe_trigger)
+    : min_frame_period(0), sys(AVT::VmbAPI::VimbaSystem::GetInstance()), n(private_nh), nn(nh), image_pub(nh, topic), diagnostics(nh, private_nh.getNamespace())
+{
+    getParams(n, cam_param);
+    commands.SetTimeout(cam_param.command_timeout_ms / 1000.0);
+    // only software triggers are known to the driver
+    track_triggers = cam_param.trigger_source == "Software";
+    // shared by every camera in this process
+    if (!ThreadPool::Shared().Configure(cam_param.debayer_threads))
+    {
+        ROS_WARN("debayer_threads %d ignored: the shared pool is sized once per process, by the first camera", cam_param.debayer_threads);
+    }
+    ROS_INFO("debayer: %d threads, %s kernel", ThreadPool::Shared().ThreadCount(), SimdLevelName(DetectSimdLevel()));
+    // also shared, the first camera that asks for it reserves it
+    if (cam_param.frame_arena_mb > 0)
+    {
+        FrameArena::Shared().Reserve((size_t)cam_param.frame_arena_mb << 20);
+    }
+    if (!ParseOutputEncoding(cam_param.output_encoding, output_encoding))
+    {
+        ROS_ERROR("unknown output_encoding '%s', using bgr8", cam_param.output_encoding.c_str());
+        output_encoding = OUTPUT_BGR8;
+    }
+    color_correction.Configure(cam_param.gamma, cam_param.gamma_lut_bits);
+    color_correction.SetGains(cam_param.wb_gain_red, cam_param.wb_gain_green, cam_param.wb_gain_blue);
+    frame_pool.SetRequestedDepth(cam_param.num_frames);
+    if (cam_param.publish_raw)
+    {
+        image_pub.Advertise(COLOR_STREAM);
+    }
+    image_pub.Advertise(PREVIEW_STREAM);
+    image_pub.Advertise(MONO_STREAM);
+    mono_full_res = cam_param.mono_mode == "green";
+    if (!mono_full_res && cam_param.mono_mode != "quad")
+    {
+        ROS_ERROR("unknown mono_mode '%s', using quad", cam_param.mono_mode.c_str());
+    }
+    worker.reset(new FrameWorker(cam_param.frame_queue_size, std::bind(&AVTCamera::ProcessFrame, this, std::placeholders::_1)));
+    worker->SetCpu(cam_param.cpu);
+    if (subscribe_trigger)
+    {
+        trigger.reset(new TriggerListener(nn, n, std::bind(&AVTCamera::TriggerImage, this)));
+    }
+    white_balance_sub = n.subscribe("white_balance", 1, &AVTCamera::whiteBalanceCb, this);
+    if (track_triggers)
+    {
+        trigger_info_pub = nn.advertise<sensor_msgs::TimeReference>("trigger_info", 10);
+    }
+    loadCalibration();
+    diagnostics.Add(timing);
+    diagnostics.Add("trigger command", commands.Latency("TriggerSoftware"));
+    diagnostics.Add("trigger to frame", trigger_tracker.latency);
+    if (trigger)
+    {
+        diagnostics.Add("trigger dispatch", trigger->dispatch);
+        diagnostics.Add("trigger latency", trigger->latency);
+    }
+}
+
+void AVTCamera::loadCalibration()
+{
+    if (cam_param.camera_info_url_.empty())
+    {
+        return;
+    }
+    // camera_info and set_camera_info live next to the images, in nh's namespace
+    info_manager.reset(new camera_info_manager::CameraInfoManager(nn, "avt_camera"));
+    if (!info_manager->validateURL(cam_param.camera_info_url_) || !info_manager->loadCameraInfo(cam_param.camera_info_url_))
+    {
+        ROS_ERROR("failed to load the calibration from %s", cam_param.camera_info_url_.c_str());
+        return;
+    }
+    camera_info = info_manager->getCameraInfo();
+    camera_info_pub = nn.advertise<sensor_msgs::CameraInfo>("camera_info", 1);
+    if (rectifier.Configure(camera_info))
+    {
+        image_pub.Advertise(RECT_STREAM);
+    }
+}
+
+bool AVTCamera::EnableMatchImage(int downscale, const cv::Rect &roi, const std::function<bool()> &wanted)
+{
+    if (!info_manager || !match_rectifier.Configure(camera_info, downscale, roi))
+    {
+        return false;
+    }
+    match_wanted = wanted;
+    return true;
+}
+
+void AVTCamera::PublishImage(const sensor_msgs::ImagePtr &image, unsigned long long ts_cam)
+{
+    image_pub.PublishImage(image, ts_cam);
+    if (info_manager)
+    {
+        std::lock_guard<std::mutex> lock(camera_info_mutex);
+        if (!camera_info_msg || !camera_info_msg.unique())
+        {
+            camera_info_msg = boost::make_shared<sensor_msgs::CameraInfo>(camera_info);
+        }
+        camera_info_msg->header.stamp = ros::Time().fromNSec(ts_cam);
+        camera_info_msg->header.frame_id = image->header.frame_id;
+        camera_info_pub.publish(camera_info_msg);
+    }
+    // roscpp renumbers header.seq on the wire, so the sequence number travels on its own topic
+    ros::Time trigger_stamp;
+    if (track_triggers && trigger_info_pub.getNumSubscribers() > 0 && trigger_tracker.TriggerStamp(image->header.seq, trigger_stamp))
+    {
+        std::lock_guard<std::mutex> lock(camera_info_mutex);
+        if (!trigger_info_msg || !trigger_info_msg.unique())
+        {
+            trigger_info_msg = boost::make_shared<sensor_msgs::TimeReference>();
+        }
+        trigger_info_msg->header.stamp = ros::Time().fromNSec(ts_cam);
+        trigger_info_msg->header.frame_id = image->header.frame_id;
+        trigger_info_msg->time_ref = trigger_stamp;
+        char seq[16];
+        snprintf(seq, sizeof(seq), "%u", image->header.seq);
+        trigger_info_msg->source = seq;
+        trigger_info_pub.publish(trigger_info_msg);
+    }
+}
+
+void AVTCamera::ProcessFrame(FrameLease &lease)
+{
+    const AVT::VmbAPI::FramePtr &pFrame = lease.Frame();
+    VmbUchar_t *pImage = NULL; // frame data will be put here to be converted to cv::Mat
+    VmbFrameStatusType eReceiveStatus ;
+    if( VmbErrorSuccess == pFrame->GetReceiveStatus( eReceiveStatus ) && VmbFrameStatusComplete == eReceiveStatus )
+    {
+        //  successfully received frame
+        if (VmbErrorSuccess == pFrame->GetImage(pImage))
+        {
+            unsigned long long ts_cam = 0;
+            pFrame->GetTimestamp(ts_cam);
+
+            VmbUint32_t width=688;	//1600
+            VmbUint32_t height=512;  //1200
+            pFrame->GetHeight(height);
+            pFrame->GetWidth(width);
+            //ROS_INFO("received an image");
+            cv::Mat image = cv::Mat(height,width, CV_8UC1, pImage);
+            VmbPixelFormatType format = VmbPixelFormatBayerRG8;
+            pFrame->GetPixelFormat(format);
+            sensor_msgs::ImagePtr raw_msg, color_msg, preview_msg, mono_msg, rect_msg, match_msg;
+            if (cam_param.publish_raw)
+            {
+                // the camera buffer goes back into the queue below, so the raw image needs its one copy
+                const char *encoding = RawEncoding(format);
+                if (encoding)
+                {
+                    raw_msg = image_pub.AcquireImage(height, width, encoding, width);
+                    std::memcpy(raw_msg->data.data(), pImage, raw_msg->data.size());
+                }
+                else
+                {
+                    ROS_ERROR_THROTTLE(5.0, "publish_raw: unsupported pixel format 0x%x", (unsigned int)format);
+                }
+            }
+            // one lookup per frame picks the kernel for what the camera actually delivered.
+            // Holding the table keeps it alive for this frame if the gains change meanwhile.
+            std::shared_ptr<const ColorLut> lut = color_correction.Current();
+            ConvertKernel kernel = conversions.Find(format, output_encoding, lut != NULL);
+            if (!kernel)
+            {
+                ROS_ERROR_THROTTLE(5.0, "cannot convert pixel format 0x%x to %s", (unsigned int)format, EncodingName(output_encoding));
+            }
+            // in raw mode color is only computed while somebody listens to the color topic
+            else if (!cam_param.publish_raw || image_pub.HasSubscribers(COLOR_STREAM))
+            {
+                // convert straight into a recycled message, no intermediate Mat and no copy on publish
+                const int channels = OutputChannels(output_encoding);
+                color_msg = image_pub.AcquireImage(height, width, EncodingName(output_encoding), width * channels);
+                cv::Mat color = MessagePublisher::WrapImage(color_msg, CV_8UC(channels));
+                debayer.Convert(image, color, kernel, lut.get());
+            }
+            // the preview is made from the mosaic directly, not from the full-resolution color image
+            ConvertKernel preview_kernel = conversions.FindPreview(format, output_encoding, lut != NULL);
+            if (preview_kernel && width >= 2 && height >= 2 && image_pub.HasSubscribers(PREVIEW_STREAM))
+            {
+                const int channels = OutputChannels(output_encoding);
+                preview_msg = image_pub.AcquireImage(height / 2, width / 2, EncodingName(output_encoding), (width / 2) * channels);
+                cv::Mat preview = MessagePublisher::WrapImage(preview_msg, CV_8UC(channels));
+                debayer.Convert(image, preview, preview_kernel, lut.get());
+            }
+            // mono for the trackers, also straight from the mosaic and linear (no white balance or gamma)
+            if (image_pub.HasSubscribers(MONO_STREAM))
+            {
+                const unsigned int mono_height = mono_full_res ? height : height / 2;
+                const unsigned int mono_width = mono_full_res ? width : width / 2;
+                ConvertKernel mono_kernel = mono_full_res ? conversions.Find(format, OUTPUT_GREEN8) : conversions.FindPreview(format, OUTPUT_MONO8);
+                if (mono_kernel && mono_height > 0 && mono_width > 0)
+                {
+                    mono_msg = image_pub.AcquireImage(mono_height, mono_width, "mono8", mono_width);
+                    cv::Mat mono = MessagePublisher::WrapImage(mono_msg, CV_8UC1);
+                    debayer.Convert(image, mono, mono_kernel);
+                }
+            }
+            // rectified color: from the color image if there is one, else debayered band by band into the remap
+            if (kernel && rectifier.Configured() && image_pub.HasSubscribers(RECT_STREAM))
+            {
+                if (!rectifier.Fits(width, height))
+                {
+                    ROS_ERROR_THROTTLE(5.0, "the calibration does not match the %ux%u image, not rectifying", (unsigned int)width, (unsigned int)height);
+                }
+                else
+                {
+                    const int channels = OutputChannels(output_encoding);
+                    rect_msg = image_pub.AcquireImage(height, width, EncodingName(output_encoding), width * channels);
+                    cv::Mat rect = MessagePublisher::WrapImage(rect_msg, CV_8UC(channels));
+                    if (color_msg)
+                    {
+                        rectifier.Remap(MessagePublisher::WrapImage(color_msg, CV_8UC(channels)), rect);
+                    }
+                    else
+                    {
+                        rectifier.ConvertRemap(image, rect, kernel, lut.get());
+                    }
+                }
+            }
+            // linear like the mono topic: block matching wants the sensor's response, not a display curve
+            if (match_rectifier.Configured() && match_wanted && match_wanted())
+            {
+                ConvertKernel match_kernel = conversions.Find(format, OUTPUT_MONO8);
+                if (match_kernel && match_rectifier.Fits(width, height))
+                {
+                    match_msg = image_pub.AcquireImage(match_rectifier.Height(), match_rectifier.Width(), "mono8", match_rectifier.Width());
+                    cv::Mat match = MessagePublisher::WrapImage(match_msg, CV_8UC1);
+                    match_rectifier.ConvertRemap(image, match, match_kernel, NULL);
+                }
+            }
+            // the trigger this frame answers, 0 if none; read before the lease gives the buffer back
+            uint32_t trigger_seq = 0;
+            if (track_triggers)
+            {
+                VmbUint64_t frame_id = 0;
+                const bool frame_id_valid = VmbErrorSuccess == pFrame->GetFrameID(frame_id);
+                uint64_t delivered_ns = lease.DeliveredNs();
+                if (delivered_ns == 0)
+                {
+                    delivered_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+                trigger_seq = trigger_tracker.OnFrame(frame_id_valid, frame_id, delivered_ns);
+            }
+            lease.Requeue();   // I can queue frame here because image is already transformed.
+            // every message of the frame carries the camera's frame and the trigger (for subscribers in
+            // this process); the recycled ones would otherwise keep the last frame's. The match image
+            // takes the frame on to the disparity. Rectified images share the camera's optical frame.
+            const sensor_msgs::ImagePtr frame_msgs[] = { raw_msg, color_msg, preview_msg, mono_msg, rect_msg, match_msg };
+            for (size_t i = 0; i < sizeof(frame_msgs) / sizeof(frame_msgs[0]); ++i)
+            {
+                if (frame_msgs[i])
+                {
+                    frame_msgs[i]->header.frame_id = cam_param.frame_id;
+                    frame_msgs[i]->header.seq = trigger_seq;
+                }
+            }
+            // the main topic carries raw in raw mode, color otherwise
+            const sensor_msgs::ImagePtr &main_msg = cam_param.publish_raw ? raw_msg : color_msg;
+            if (main_msg)
+            {
+                if (image_handler)
+                {
+                    image_handler(main_msg, match_msg, ts_cam);
+                }
+                else
+                {
+                    PublishImage(main_msg, ts_cam);
+                }
+            }
+            if (color_msg && cam_param.publish_raw)
+            {
+                image_pub.PublishImage(color_msg, ts_cam, COLOR_STREAM); //without ts_cam
+            }
+            if (preview_msg)
+            {
+                image_pub.PublishImage(preview_msg, ts_cam, PREVIEW_STREAM);
+            }
+            if (mono_msg)
+            {
+                image_pub.PublishImage(mono_msg, ts_cam, MONO_STREAM);
+            }
+            if (rect_msg)
+            {
+                image_pub.PublishImage(rect_msg, ts_cam, RECT_STREAM);
+            }
+            frame_pool.CheckStarvation();
+            if (track_triggers)
+            {
+                trigger_tracker.CheckMissed();
+            }
+            return;
+        }
+    }
+    else
+    {
+        // unsuccessfully received frame
+        ROS_INFO("receiving frame failed.");
+    }
+    // nothing was taken from the frame, the worker re-queues it when it drops the lease
+}
+
+
+void AVTCamera::whiteBalanceCb(const std_msgs::ColorRGBA::ConstPtr& gains)
+{
+    if (gains->r < 0 || gains->g < 0 || gains->b < 0)
+    {
+        ROS_ERROR("white_balance: gains must not be negative");
+        return;
+    }
+    color_correction.SetGains(gains->r, gains->g, gains->b);
+    ROS_INFO("white balance gains r %.3f g %.3f b %.3f", gains->r, gains->g, gains->b);
+}
+
+void AVTCamera::getParams(ros::NodeHandle &n, CameraParam &cam_param)
+{
+    //Todo remmber own
+    int binninghorizontal, binningvertical;
+
+    int height,width,exposure,gain;
+    int offsetX, offsetY;
+    double fps;
+    if(n.getParam("cam_IP", cam_param.cam_IP))
+    {
+        ROS_INFO("Got camera IP %s", cam_param.cam_IP.c_str());
+    }
+    else
+    {
+        cam_param.cam_IP = "169.254.49.41";   // dafault IP
+        ROS_ERROR("failed to get param 'cam_IP' ");
+    }
+
+    if(n.getParam("image_height", height))
+    {
+        ROS_INFO("Got image_height %i", height);
+    }
+    else
+    {
+        height = 1200;
+        ROS_ERROR("failed to get param 'image_height' ");
+    }
+
+    if(n.getParam("image_width", width))
+    {
+        ROS_INFO("Got image_width %i", width);
+    }
+    else
+    {
+        width = 1600;
+        ROS_ERROR("failed to get param 'image_width' ");
+    }
+
+    if(n.getParam("offsetX", offsetX))
+    {
+        ROS_INFO("Got offsetX %i", offsetX);
+    }
+    else
+    {
+        offsetX = 0;
+        ROS_ERROR("failed to get param 'offsetX' ");
+    }
+
+    if(n.getParam("offsetY", offsetY))
+    {
+        ROS_INFO("Got offsetY %i", offsetY);
+    }
+    else
+    {
+        offsetY = 0;
+        ROS_ERROR("failed to get param 'offsetY' ");
+    }
+
+    if(n.getParam("exposure_in_us", exposure))
+    {
+        ROS_INFO("Got exposure_in_us %i", exposure);
+    }
+    else
+    {
+        exposure = 10000;
+        ROS_ERROR("failed to get param 'exposure_in_us' ");
+    }
+
+    if(n.getParam("frame_rate", fps))
+    {
+        ROS_INFO("Got frame_rate %f", fps);
+    }
+    else
+    {
+        fps = 20;
+        ROS_ERROR("failed to get param 'frame_rate' ");
+    }
+
+    if(n.getParam("trigger_source", cam_param.trigger_source))
+    {
+        ROS_INFO_STREAM("trigger source is " << cam_param.trigger_source);
+    }
+    else
+    {
+        cam_param.trigger_source = "FreeRun";
+        ROS_ERROR("failed to get param 'trigger_souorce' ");
+    }
+
+    if(n.getParam("exposure_auto", cam_param.exposure_auto))
+    {
+        ROS_INFO("exposure_auto %s", cam_param.exposure_auto ? "enabled" : "disabled");
+    }
+    else
+    {
+        cam_param.exposure_auto = false;
+        ROS_ERROR("failed to get param 'exposure_auto' ");
+    }
+
+    if(n.getParam("balance_white_auto", cam_param.balance_white_auto))
+    {
+        ROS_INFO("balance_white_auto %s", cam_param.balance_white_auto ? "enabled" : "disabled");
+    }
+    else
+    {
+        cam_param.balance_white_auto = false;
+        ROS_ERROR("failed to get param 'balance_white_auto' ");
+    }
+
+    if(n.getParam("gain", gain))
+    {
+        ROS_INFO("gain is %i dB", gain);
+    }
+    else
+    {
+        gain = 0;
+        ROS_ERROR("failed to get param 'gain' ");
+    }
+
+    //Todo remember own
+    if(n.getParam("binninghorizontal", binninghorizontal))
+    {
+        ROS_INFO("Got binninghorizontal %i", binninghorizontal);
+    }
+    else
+    {
+        binninghorizontal = 1;
+        ROS_ERROR("failed to get param 'binninghorizontal' ");
+    }
+    if(n.getParam("binningvertical", binningvertical))
+    {
+        ROS_INFO("Got binningvertical %i", binningvertical);
+    }
+    else
+    {
+        binningvertical = 1;
+        ROS_ERROR("failed to get param 'binningvertical' ");
+    }
+    if(n.getParam("publish_raw", cam_param.publish_raw))
+    {
+        ROS_INFO("publish_raw %s", cam_param.publish_raw ? "enabled" : "disabled");
+    }
+    else
+    {
+        cam_param.publish_raw = false;
+        ROS_INFO("param 'publish_raw' not set, publishing color");
+    }
+    if(n.getParam("debayer_threads", cam_param.debayer_threads))
+    {
+        ROS_INFO("Got debayer_threads %i", cam_param.debayer_threads);
+    }
+    else
+    {
+        cam_param.debayer_threads = 0;
+        ROS_INFO("param 'debayer_threads' not set, using one thread per core");
+    }
+    if(n.getParam("output_encoding", cam_param.output_encoding))
+    {
+        ROS_INFO("Got output_encoding %s", cam_param.output_encoding.c_str());
+    }
+    else
+    {
+        cam_param.output_encoding = "bgr8";
+        ROS_INFO("param 'output_encoding' not set, using bgr8");
+    }
+    if(n.getParam("mono_mode", cam_param.mono_mode))
+    {
+        ROS_INFO("Got mono_mode %s", cam_param.mono_mode.c_str());
+    }
+    else
+    {
+        cam_param.mono_mode = "quad";
+        ROS_INFO("param 'mono_mode' not set, using quad");
+    }
+    if(n.getParam("gamma", cam_param.gamma))
+    {
+        ROS_INFO("Got gamma %f", cam_param.gamma);
+    }
+    else
+    {
+        cam_param.gamma = 1.0;
+        ROS_INFO("param 'gamma' not set, using a linear output");
+    }
+    if(n.getParam("gamma_lut_bits", cam_param.gamma_lut_bits))
+    {
+        ROS_INFO("Got gamma_lut_bits %i", cam_param.gamma_lut_bits);
+    }
+    else
+    {
+        cam_param.gamma_lut_bits = 12;
+        ROS_INFO("param 'gamma_lut_bits' not set, using %i", cam_param.gamma_lut_bits);
+    }
+    if(n.getParam("wb_gain_red", cam_param.wb_gain_red))
+    {
+        ROS_INFO("Got wb_gain_red %f", cam_param.wb_gain_red);
+    }
+    else
+    {
+        cam_param.wb_gain_red = 1.0;
+        ROS_INFO("param 'wb_gain_red' not set, using 1.0");
+    }
+    if(n.getParam("wb_gain_green", cam_param.wb_gain_green))
+    {
+        ROS_INFO("Got wb_gain_green %f", cam_param.wb_gain_green);
+    }
+    else
+    {
+        cam_param.wb_gain_green = 1.0;
+        ROS_INFO("param 'wb_gain_green' not set, using 1.0");
+    }
+    if(n.getParam("wb_gain_blue", cam_param.wb_gain_blue))
+    {
+        ROS_INFO("Got wb_gain_blue %f", cam_param.wb_gain_blue);
+    }
+    else
+    {
+        cam_param.wb_gain_blue = 1.0;
+        ROS_INFO("param 'wb_gain_blue' not set, using 1.0");
+    }
+    if(n.getParam("num_frames", cam_param.num_frames))
+    {
+        ROS_INFO("Got num_frames %i", cam_param.num_frames);
+    }
+    else
+    {
+        cam_param.num_frames = 0;
+        ROS_INFO("param 'num_frames' not set, sizing the frame pool automatically");
+    }
+    if(n.getParam("frame_queue_size", cam_param.frame_queue_size))
+    {
+        ROS_INFO("Got frame_queue_size %i", cam_param.frame_queue_size);
+    }
+    else
+    {
+        cam_param.frame_queue_size = 8;
+        ROS_INFO("param 'frame_queue_size' not set, using %i", cam_param.frame_queue_size);
+    }
+    if(n.getParam("cpu", cam_param.cpu))
+    {
+        ROS_INFO("Got cpu %i", cam_param.cpu);
+    }
+    else
+    {
+        cam_param.cpu = -1;
+        ROS_INFO("param 'cpu' not set, frame worker not pinned");
+    }
+    if(n.getParam("stream_bytes_per_second", cam_param.stream_bytes_per_second))
+    {
+        ROS_INFO("Got stream_bytes_per_second %i", cam_param.stream_bytes_per_second);
+    }
+    else
+    {
+        cam_param.stream_bytes_per_second = 0;
+        ROS_INFO("param 'stream_bytes_per_second' not set, using the camera's setting");
+    }
+    if(n.getParam("trigger_async", cam_param.trigger_async))
+    {
+        ROS_INFO("trigger_async %s", cam_param.trigger_async ? "enabled" : "disabled");
+    }
+    else
+    {
+        cam_param.trigger_async = true;
+        ROS_INFO("param 'trigger_async' not set, triggers return before the camera reports them done");
+    }
+    if(n.getParam("command_timeout_ms", cam_param.command_timeout_ms))
+    {
+        ROS_INFO("Got command_timeout_ms %i", cam_param.command_timeout_ms);
+    }
+    else
+    {
+        cam_param.command_timeout_ms = 500;
+        ROS_INFO("param 'command_timeout_ms' not set, using %i", cam_param.command_timeout_ms);
+    }
+    if(n.getParam("trigger_frame_timeout_ms", cam_param.trigger_frame_timeout_ms))
+    {
+        ROS_INFO("Got trigger_frame_timeout_ms %i", cam_param.trigger_frame_timeout_ms);
+    }
+    else
+    {
+        cam_param.trigger_frame_timeout_ms = 0;
+        ROS_INFO("param 'trigger_frame_timeout_ms' not set, derived from the frame period at start");
+    }
+    if(n.getParam("frame_arena_mb", cam_param.frame_arena_mb))
+    {
+        ROS_INFO("Got frame_arena_mb %i", cam_param.frame_arena_mb);
+    }
+    else
+    {
+        cam_param.frame_arena_mb = 0;
+        ROS_INFO("param 'frame_arena_mb' not set, frame buffers allocated per camera");
+    }
+    if(n.getParam("output_buffers", cam_param.output_buffers))
+    {
+        ROS_INFO("Got output_buffers %i", cam_param.output_buffers);
+    }
+    else
+    {
+        cam_param.output_buffers = 0;
+        ROS_INFO("param 'output_buffers' not set, output messages allocated as needed");
+    }
+    if(n.getParam("camera_info_url", cam_param.camera_info_url_))
+    {
+        ROS_INFO("Got camera_info_url %s", cam_param.camera_info_url_.c_str());
+    }
+    else
+    {
+        cam_param.camera_info_url_ = "";
+        ROS_INFO("param 'camera_info_url' not set, no camera_info and no rectification");
+    }
+    if(n.getParam("frame_id", cam_param.frame_id))
+    {
+        ROS_INFO("Got frame_id %s", cam_param.frame_id.c_str());
+    }
+    else
+    {
+        // the camera's own namespace, e.g. cam_1 of ~cam_1/, tells the cameras of a rig apart
+        const std::string &ns = n.getNamespace();
+        cam_param.frame_id = ns.substr(ns.find_last_of('/') + 1) + "_optical_frame";
+        ROS_INFO("param 'frame_id' not set, using %s", cam_param.frame_id.c_str());
+    }
+    if(n.getParam("ptp_mode", cam_param.ptp_mode))
+    {
+        ROS_INFO_STREAM("ptp_mode is " << cam_param.ptp_mode);
+    }
+    else
+    {
+        cam_param.ptp_mode = "Off";
+        ROS_ERROR("failed to get param 'ptp_mode' ");
+    }
+
+
+
+    cam_param.binninghorizontal = binninghorizontal;
+    cam_param.binningvertical = binningvertical;
+
+
+    cam_param.image_height = height;
+    cam_param.image_width = width;
+    cam_param.exposure_in_us = exposure;
+    cam_param.frame_rate = fps;
+    cam_param.gain = gain;
+    cam_param.offsetX = offsetX;
+    cam_param.offsetY = offsetY;
+}
+
+void AVTCamera::StartAcquisition()
+{
+    StartupVimba(sys);
+    VmbErrorType res = sys.OpenCameraByID( cam_param.cam_IP.c_str(), VmbAccessModeFull, camera );
+    if (VmbErrorSuccess != res)
+    {
+        ROS_ERROR("failed to open the camera");
+    }
+    else
+    {
+        SetCameraFeature();
+        min_frame_period = QueryMinFramePeriod();
+        if (trigger)
+        {
+            trigger->SetMinPeriod(min_frame_period);
+        }
+        trigger_tracker.SetMinPeriod(min_frame_period);
+        if (cam_param.trigger_frame_timeout_ms > 0)
+        {
+            trigger_tracker.SetTimeout(cam_param.trigger_frame_timeout_ms / 1000.0);
+        }
+        else
+        {
+            // exposure, readout and transfer take a few frame periods at most; 500 ms if the period is unknown
+            const double timeout = min_frame_period > 0 ? 0.1 + 4 * min_frame_period : 0.5;
+            trigger_tracker.SetTimeout(timeout);
+            ROS_INFO("trigger_frame_timeout_ms: %.0f ms", timeout * 1e3);
+        }
+        camera->GetFeatureByName("PayloadSize", pFeature );
+        pFeature->GetValue(nPLS );
+        
+        if (!frame_pool.Announce(camera, nPLS, AVT::VmbAPI::IFrameObserverPtr(new FrameObserver(camera,*worker,frame_pool,timing)), cam_param.frame_rate))
+        {
+            FrameArena::Shared().LogStats();
+            ROS_ERROR("not enough frame buffers, the camera does not start");
+            return;
+        }
+        FrameArena::Shared().LogStats();
+        if (cam_param.output_buffers > 0)
+        {
+            // the largest message a frame makes: the raw buffer, or a full-size color (or rectified) image
+            VmbInt64_t width = 0, height = 0;
+            camera->GetFeatureByName("Width", pFeature);
+            pFeature->GetValue(width);
+            camera->GetFeatureByName("Height", pFeature);
+            pFeature->GetValue(height);
+            const size_t bytes = std::max((size_t)nPLS, (size_t)(width * height * OutputChannels(output_encoding)));
+            image_pub.Preallocate(cam_param.output_buffers, bytes);
+            ROS_INFO("output buffers: %i messages of %.1f MB", cam_param.output_buffers, bytes / 1048576.0);
+        }
+        
+        trigger_tracker.Reset();
+        // Start the capture engine (API)
+        worker->Start();
+        camera->StartCapture();
+        // Put frames into the frame queue
+        frame_pool.QueueAll();
+        // Start the acquisition engine ( camera )
+        camera->GetFeatureByName("AcquisitionStart", pFeature );
+        commands.Run(pFeature, "AcquisitionStart");
+        // looked up once, not per trigger
+        std::lock_guard<std::mutex> lock(trigger_mutex);
+        if (VmbErrorSuccess != camera->GetFeatureByName("TriggerSoftware", trigger_feature))
+        {
+            trigger_feature.reset();
+        }
+    }
+}
+
+void AVTCamera::StopAcquisition()
+{
+    {
+        std::lock_guard<std::mutex> lock(trigger_mutex);
+        trigger_feature.reset();
+    }
+    camera->GetFeatureByName("AcquisitionStop", pFeature );
+    commands.Run(pFeature, "AcquisitionStop");
+    // Stop the capture engine (API)
+    // Flush the frame queue
+    // Revoke all frames from the API
+    camera->EndCapture();
+    worker->Stop();
+    camera->FlushQueue();
+    camera->RevokeAllFrames();
+    // Unregister the frame observers / callbacks
+    frame_pool.Release();
+    image_pub.LogStats();
+    commands.LogStats();
+    if (trigger)
+    {
+        trigger->LogStats();
+    }
+    trigger_tracker.LogStats();
+    FrameArena::Shared().LogStats();
+    ShutdownVimba(sys);
+}
+
+void AVTCamera::SetCameraImageSize(const VmbInt64_t& width, const VmbInt64_t& height, const VmbInt64_t& offsetX, const VmbInt64_t& offsetY, const VmbInt64_t& binninghorizontal, const VmbInt64_t& binningvertical)
+{
+	// set the offset value to centralize the image.
+	//VmbInt64_t offset_x = int((1600 - width) / 2);
+	//VmbInt64_t offset_y = int((1200 - height) / 2);
+	VmbErrorType err;
+	err = camera->GetFeatureByName("Height", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "Height", height);
+		if (VmbErrorSuccess != err)
+		{
+            ROS_ERROR("failed to set height.");
+		}
+	}
+
+	err = camera->GetFeatureByName("Width", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "Width", width);
+		if (VmbErrorSuccess != err)
+		{
+            ROS_ERROR("failed to set width");
+		}
+	}
+
+	
+	err = camera->GetFeatureByName("OffsetX", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "OffsetX", offsetX);
+		if (VmbErrorSuccess != err)
+		{
+            ROS_ERROR("failed to set OffsetX");
+		}
+	}
+
+	err = camera->GetFeatureByName("OffsetY", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "OffsetY", offsetY);
+		if (VmbErrorSuccess != err)
+		{
+            ROS_ERROR("failed to set OffsetY");
+		}
+	}
+
+
+	//Todo remmeber own
+    //VmbInt64_t BinningHorizontal_loc=2;
+    //VmbInt64_t BinningVertical_loc=2;
+
+    err = camera->GetFeatureByName("BinningHorizontal", pFeature);
+    if (err == VmbErrorSuccess)
+    {
+        err = commands.SetValue(pFeature, "BinningHorizontal", binninghorizontal);
+        if (VmbErrorSuccess != err)
+        {
+            ROS_ERROR("failed to set BinningHorizontal");
+        }
+    }
+    err = camera->GetFeatureByName("BinningVertical", pFeature);
+    if (err == VmbErrorSuccess)
+    {
+        err = commands.SetValue(pFeature, "BinningVertical", binningvertical);
+        if (VmbErrorSuccess != err)
+        {
+            ROS_ERROR("failed to set BinningVertical");
+        }
+    }
+	
+}
+
+void AVTCamera::SetExposureTime(const VmbInt64_t & time_in_us)
+{
+	VmbErrorType err;
+	err = camera->GetFeatureByName("ExposureTimeAbs", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "ExposureTimeAbs", (double)time_in_us); 
+		if (VmbErrorSuccess != err)
+		{
+			ROS_ERROR("failed to set ExposureTimeAbs");
+		}
+	}
+}
+
+void AVTCamera::SetAcquisitionFramRate(const double & fps)
+{
+    VmbErrorType err;
+	err = camera->GetFeatureByName("AcquisitionFrameRateAbs", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "AcquisitionFrameRateAbs", fps); 
+		if (VmbErrorSuccess != err)
+		{
+            ROS_ERROR("failed to set AcquisitionFrameRateAbs feature");
+		}
+	}
+    else
+    {
+        ROS_ERROR("failed to open AcquisitionFrameRateAbs feature");
+    }
+}
+
+void AVTCamera::SetGain(const VmbInt64_t & gain)
+{
+    VmbErrorType err;
+	err = camera->GetFeatureByName("Gain", pFeature);
+	if (err == VmbErrorSuccess)
+	{
+		err = commands.SetValue(pFeature, "Gain", (double)gain); 
+		if (VmbErrorSuccess != err)
+		{
+            ROS_ERROR("failed to set camera gain");
+		}
+	}
+    else
+    {
+        ROS_ERROR("failed to open gain feature");
+    }
+}
+
+double AVTCamera::QueryMinFramePeriod()
+{
+    // AcquisitionFrameRateAbs's maximum follows the ROI, binning and bandwidth; an exposure longer
+    // than that period sets the pace instead
+    double min_fps = 0, max_fps = 0;
+    double period = 0;
+    if (VmbErrorSuccess == camera->GetFeatureByName("AcquisitionFrameRateAbs", pFeature) &&
+        VmbErrorSuccess == pFeature->GetRange(min_fps, max_fps) && max_fps > 0)
+    {
+        period = 1.0 / max_fps;
+    }
+    else
+    {
+        ROS_WARN("cannot read the range of AcquisitionFrameRateAbs");
+    }
+    double exposure_us = 0;
+    if (VmbErrorSuccess == camera->GetFeatureByName("ExposureTimeAbs", pFeature) && VmbErrorSuccess == pFeature->GetValue(exposure_us))
+    {
+        period = std::max(period, exposure_us * 1e-6);
+    }
+    return period;
+}
+
+void AVTCamera::TriggerImage()
+{
+    // called on the trigger thread, so it keeps off pFeature, which belongs to the setters
+    std::lock_guard<std::mutex> lock(trigger_mutex);
+    if (!trigger_feature)
+    {
+        return;
+    }
+    // numbered before it is sent: with a synchronous trigger the frame can be on the worker before Run returns
+    uint32_t seq = 0;
+    if (track_triggers)
+    {
+        seq = trigger_tracker.OnTrigger(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), ros::Time::now());
+    }
+    // async: back as soon as the command is on its way, the completion thread waits for the camera
+    VmbErrorType err = cam_param.trigger_async ? commands.RunAsync(trigger_feature, "TriggerSoftware") : commands.Run(trigger_feature, "TriggerSoftware");
+    if (VmbErrorSuccess != err)
+    {
+        ROS_ERROR_THROTTLE(1.0, "TriggerSoftware failed (%d)", (int)err);
+        // A timeout comes after the command went out, and the camera usually still takes the frame:
+        // withdrawing would match that frame to the next trigger. Unanswered, it expires as missed.
+        if (seq && VmbErrorTimeout != err)
+        {
+            trigger_tracker.Withdraw(seq);
+        }
+    }
+}
+
+// This must be called after opening the camera.
+void AVTCamera::SetCameraFeature()
+{
+    VmbErrorType err;
+    SetExposureTime(cam_param.exposure_in_us);
+    SetCameraImageSize(cam_param.image_width, cam_param.image_height, cam_param.offsetX, cam_param.offsetY, cam_param.binninghorizontal, cam_param.binningvertical);
+    SetAcquisitionFramRate(cam_param.frame_rate);
+    SetGain(cam_param.gain);
+
+    // several cameras on one link have to share it
+    if (cam_param.stream_bytes_per_second > 0)
+    {
+        err = camera->GetFeatureByName("StreamBytesPerSecond", pFeature);
+        if (VmbErrorSuccess == err)
+        {
+            err = commands.SetValue(pFeature, "StreamBytesPerSecond", (VmbInt64_t)cam_param.stream_bytes_per_second);
+        }
+        if (VmbErrorSuccess != err)
+        {
+            ROS_ERROR("failed to set StreamBytesPerSecond");
+        }
+    }
+
+    // Set acquisition mode
+    camera->GetFeatureByName("AcquisitionMode", pFeature);
+    err = commands.SetValue(pFeature, "AcquisitionMode", "Continuous");
+    if (VmbErrorSuccess != err)
+    {
+        ROS_ERROR("Failed to set acquisition mode");
+    }
+
+    //Todo remmeber own
+    // Set ptp_mode
+    camera->GetFeatureByName("PtpMode", pFeature);
+    if(cam_param.ptp_mode == "Slave")
+    {
+        err = commands.SetValue(pFeature, "PtpMode", "Slave");
+    }
+    else if(cam_param.ptp_mode == "Master")
+    {
+        err = commands.SetValue(pFeature, "PtpMode", "Master");
+    }
+    else if(cam_param.ptp_mode == "Auto")
+    {
+        err = commands.SetValue(pFeature, "PtpMode", "Auto");
+    }
+    else
+    {
+        err = commands.SetValue(pFeature, "PtpMode", "Off");
+        if(cam_param.ptp_mode != "Off")
+        {
+            ROS_ERROR("Invalid ptp_mode. Valid values are from set {Off, Slave, Master, Auto}");
+        }
+    }
+
+
+
+    // Set Trigger source
+    camera->GetFeatureByName("TriggerSource", pFeature);
+    if(cam_param.trigger_source == "Software")
+    {
+        err = commands.SetValue(pFeature, "TriggerSource", "Software");
+    }
+    else if(cam_param.trigger_source == "FixedRate")
+    {
+        err = commands.SetValue(pFeature, "TriggerSource", "FixedRate");
+    }
+    else
+    {
+        err = commands.SetValue(pFeature, "TriggerSource", "Freerun");
+        if(cam_param.trigger_source != "FreeRun")
+        {
+            ROS_ERROR("Invalid trigger source value. Valid values are from set {FixedRate, Software, FreeRun}");
+        }
+    }
+    
+    if (VmbErrorSuccess != err)
+    {
+        ROS_ERROR("Failed to set Trigger Source");
+    }
+
+    // Set Exposure Auto
+    camera->GetFeatureByName("ExposureAuto", pFeature);
+    if(cam_param.exposure_auto)
+    {
+        err = commands.SetValue(pFeature, "ExposureAuto", "Continuous");
+    }
+    else
+    {
+        err = commands.SetValue(pFeature, "ExposureAuto", "Off");
+    }
+    if (VmbErrorSuccess != err)
+    {
+        ROS_ERROR("failed to set ExposureAuto");
+    }
+
+    // Set Balance White Auto
+    camera->GetFeatureByName("BalanceWhiteAuto", pFeature);
+    if(cam_param.balance_white_auto)
+    {
+        err = commands.SetValue(pFeature, "BalanceWhiteAuto", "Continuous");
+    }
+    else
+    {
+        err = commands.SetValue(pFeature, "BalanceWhiteAuto", "Off");
+    }
+    if (VmbErrorSuccess != err)
+    {
+        ROS_ERROR("failed to set BalanceWhiteAuto");
+    }
+
+}
@@ -0,0 +1,35 @@
+/*=========================================================
+The camera driver as a nodelet. Loaded into the same manager
+as its consumers (rectifier, tracker, ...), they receive the
+published sensor_msgs::ImageConstPtr itself: no serialization
+and no copy of the frame.
+===========================================================*/
+
+#include <memory>
+#include "nodelet/nodelet.h"
+#include "pluginlib/class_list_macros.h"
+#include "avt_camera_streaming/AVTCamera.h"
+
+class AVTCameraNodelet : public nodelet::Nodelet
+{
+public:
+    ~AVTCameraNodelet()
+    {
+        if (camera)
+        {
+            camera->StopAcquisition();
+        }
+    }
+
+private:
+    // same parameters and topics as the avt_triggering node, in the nodelet's namespaces
+    virtual void onInit()
+    {
+        camera.reset(new AVTCamera(getNodeHandle(), getPrivateNodeHandle()));
+        camera->StartAcquisition();
+    }
+
+    std::unique_ptr<AVTCamera> camera;
+};
+
+PLUGINLIB_EXPORT_CLASS(AVTCameraNodelet, nodelet::Nodelet)
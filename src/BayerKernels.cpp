@@ -0,0 +1,725 @@
+/*=========================================================
+Bilinear Bayer to RGB/BGR/mono kernels for the 8-bit Bayer
+formats, with SSSE3 and AVX2 versions picked at runtime.
+===========================================================*/
+
+#include "avt_camera_streaming/BayerKernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BAYER_KERNELS_X86
+#endif
+
+namespace
+{
+// parity of the red site; blue sits on the opposite parity in both directions
+template <BayerPattern P> struct PatternTraits;
+template <> struct PatternTraits<BAYER_RG> { enum { RX = 0, RY = 0 }; };
+template <> struct PatternTraits<BAYER_BG> { enum { RX = 1, RY = 1 }; };
+template <> struct PatternTraits<BAYER_GB> { enum { RX = 0, RY = 1 }; };
+template <> struct PatternTraits<BAYER_GR> { enum { RX = 1, RY = 0 }; };
+
+inline void RedSite(BayerPattern pattern, int &rx, int &ry)
+{
+    switch (pattern)
+    {
+        case BAYER_RG: rx = 0; ry = 0; break;
+        case BAYER_BG: rx = 1; ry = 1; break;
+        case BAYER_GB: rx = 0; ry = 1; break;
+        default:       rx = 1; ry = 0; break;  // BAYER_GR
+    }
+}
+
+inline int Luma(int r, int g, int b)
+{
+    return (LUMA_R * r + LUMA_G * g + LUMA_B * b + 128) >> 8;
+}
+
+// output of the reference functions, everything decided at runtime
+inline void ReferenceWrite(uint8_t *out, int r, int g, int b, OutputEncoding encoding, const ColorLut *lut)
+{
+    if (lut)
+    {
+        r = lut->r[r];
+        g = lut->g[g];
+        b = lut->b[b];
+    }
+    if (encoding == OUTPUT_MONO8)
+    {
+        out[0] = (uint8_t)Luma(r, g, b);
+    }
+    else if (encoding == OUTPUT_GREEN8)
+    {
+        out[0] = (uint8_t)g;
+    }
+    else
+    {
+        out[0] = (uint8_t)(encoding == OUTPUT_RGB8 ? r : b);
+        out[1] = (uint8_t)g;
+        out[2] = (uint8_t)(encoding == OUTPUT_RGB8 ? b : r);
+    }
+}
+
+template <OutputEncoding O> struct PixelWriter;
+template <> struct PixelWriter<OUTPUT_RGB8>
+{
+    enum { CHANNELS = 3 };
+    static void Write(uint8_t *out, int r, int g, int b) { out[0] = (uint8_t)r; out[1] = (uint8_t)g; out[2] = (uint8_t)b; }
+};
+template <> struct PixelWriter<OUTPUT_BGR8>
+{
+    enum { CHANNELS = 3 };
+    static void Write(uint8_t *out, int r, int g, int b) { out[0] = (uint8_t)b; out[1] = (uint8_t)g; out[2] = (uint8_t)r; }
+};
+template <> struct PixelWriter<OUTPUT_MONO8>
+{
+    enum { CHANNELS = 1 };
+    static void Write(uint8_t *out, int r, int g, int b) { out[0] = (uint8_t)Luma(r, g, b); }
+};
+// red and blue are never used, the compiler drops their interpolation
+template <> struct PixelWriter<OUTPUT_GREEN8>
+{
+    enum { CHANNELS = 1 };
+    static void Write(uint8_t *out, int, int g, int) { out[0] = (uint8_t)g; }
+};
+
+// LUT: map the interpolated values through the white balance / gamma table before writing
+template <OutputEncoding O, bool LUT>
+inline void Emit(uint8_t *out, int r, int g, int b, const ColorLut *lut)
+{
+    if (LUT)
+    {
+        PixelWriter<O>::Write(out, lut->r[r], lut->g[g], lut->b[b]);
+    }
+    else
+    {
+        PixelWriter<O>::Write(out, r, g, b);
+    }
+}
+
+// reflect-101: -1 -> 1, n -> n - 2. Keeps the parity, so the Bayer phase stays right.
+inline int Mirror(int i, int n)
+{
+    if (n == 1)
+    {
+        return 0;
+    }
+    return i < 0 ? -i : (i >= n ? 2 * n - 2 - i : i);
+}
+
+// one pixel with mirrored neighbours and runtime site classification.
+// The reference, and the border columns of the specialized kernels.
+inline void DebayerPixel(const uint8_t *src, size_t step, int width, int height, int x, int y,
+                         int rx, int ry, int &r, int &g, int &b)
+{
+    const uint8_t *u = src + Mirror(y - 1, height) * step;
+    const uint8_t *c = src + y * step;
+    const uint8_t *d = src + Mirror(y + 1, height) * step;
+    const int xl = Mirror(x - 1, width);
+    const int xr = Mirror(x + 1, width);
+
+    const int centre = c[x];
+    const int h = (c[xl] + c[xr] + 1) >> 1;
+    const int v = (u[x] + d[x] + 1) >> 1;
+    const int cross = (c[xl] + c[xr] + u[x] + d[x] + 2) >> 2;
+    const int diag = (u[xl] + u[xr] + d[xl] + d[xr] + 2) >> 2;
+
+    // on a red row the native colour is red at x parity rx, on a blue row it is blue at the other parity
+    const bool red_row = (y & 1) == ry;
+    const bool native = red_row ? ((x & 1) == rx) : ((x & 1) != rx);
+    const int a = native ? centre : h;      // colour of this row
+    g = native ? cross : centre;
+    const int z = native ? diag : v;        // colour of the rows above and below
+    r = red_row ? a : z;
+    b = red_row ? z : a;
+}
+
+template <OutputEncoding O, bool LUT>
+inline void BorderColumns(const uint8_t *src, size_t step, int width, int height, int y, int x0, int x1,
+                          int rx, int ry, uint8_t *out_row, const ColorLut *lut)
+{
+    for (int x = x0; x < x1; ++x)
+    {
+        int r, g, b;
+        DebayerPixel(src, step, width, height, x, y, rx, ry, r, g, b);
+        Emit<O, LUT>(out_row + PixelWriter<O>::CHANNELS * x, r, g, b, lut);
+    }
+}
+
+// interior pixels, no mirroring. RED_ROW: the colour native to this row is red.
+template <bool RED_ROW, OutputEncoding O, bool LUT>
+inline void NativePixel(const uint8_t *u, const uint8_t *c, const uint8_t *d, int x, uint8_t *out_row, const ColorLut *lut)
+{
+    const int a = c[x];
+    const int g = (c[x - 1] + c[x + 1] + u[x] + d[x] + 2) >> 2;
+    const int z = (u[x - 1] + u[x + 1] + d[x - 1] + d[x + 1] + 2) >> 2;
+    Emit<O, LUT>(out_row + PixelWriter<O>::CHANNELS * x, RED_ROW ? a : z, g, RED_ROW ? z : a, lut);
+}
+
+template <bool RED_ROW, OutputEncoding O, bool LUT>
+inline void GreenPixel(const uint8_t *u, const uint8_t *c, const uint8_t *d, int x, uint8_t *out_row, const ColorLut *lut)
+{
+    const int a = (c[x - 1] + c[x + 1] + 1) >> 1;
+    const int g = c[x];
+    const int z = (u[x] + d[x] + 1) >> 1;
+    Emit<O, LUT>(out_row + PixelWriter<O>::CHANNELS * x, RED_ROW ? a : z, g, RED_ROW ? z : a, lut);
+}
+
+// columns [x0, x1) of one row, x0 even. Works in pixel pairs so the site of every pixel is known at compile time.
+template <bool NATIVE_EVEN, bool RED_ROW, OutputEncoding O, bool LUT>
+inline void ScalarRow(const uint8_t *u, const uint8_t *c, const uint8_t *d, int x0, int x1, uint8_t *out_row, const ColorLut *lut)
+{
+    int x = x0;
+    for (; x + 1 < x1; x += 2)
+    {
+        if (NATIVE_EVEN)
+        {
+            NativePixel<RED_ROW, O, LUT>(u, c, d, x, out_row, lut);
+            GreenPixel<RED_ROW, O, LUT>(u, c, d, x + 1, out_row, lut);
+        }
+        else
+        {
+            GreenPixel<RED_ROW, O, LUT>(u, c, d, x, out_row, lut);
+            NativePixel<RED_ROW, O, LUT>(u, c, d, x + 1, out_row, lut);
+        }
+    }
+    if (x < x1)
+    {
+        if (NATIVE_EVEN)
+        {
+            NativePixel<RED_ROW, O, LUT>(u, c, d, x, out_row, lut);
+        }
+        else
+        {
+            GreenPixel<RED_ROW, O, LUT>(u, c, d, x, out_row, lut);
+        }
+    }
+}
+
+// the LUT on one finished colour row, while it is still in L1
+template <OutputEncoding O>
+inline void LutRow(uint8_t *out, int width, const ColorLut *lut)
+{
+    const uint8_t *first = O == OUTPUT_RGB8 ? lut->r : lut->b;
+    const uint8_t *last = O == OUTPUT_RGB8 ? lut->b : lut->r;
+    for (int x = 0; x < width; ++x, out += 3)
+    {
+        out[0] = first[out[0]];
+        out[1] = lut->g[out[1]];
+        out[2] = last[out[2]];
+    }
+}
+
+// Row loop shared by all instruction sets. ROW::Run converts an interior span of one row
+// starting at x = 2 and returns where it stopped; the rest is done by the scalar paths.
+// LUT: colour rows are interpolated as usual and the table is applied to the row right after,
+// there is no vector byte lookup to fuse it with. Mono needs the table before the luma sum,
+// so that case looks up per pixel on the scalar path.
+template <BayerPattern P, OutputEncoding O, template <bool, bool, OutputEncoding> class ROW, bool LUT>
+void RowsKernel(const uint8_t *src, size_t src_step, int width, int height, uint8_t *dst, size_t dst_step, int y0, int y1,
+                const ColorLut *lut)
+{
+    const int rx = PatternTraits<P>::RX;
+    const int ry = PatternTraits<P>::RY;
+    const bool per_pixel = LUT && PixelWriter<O>::CHANNELS == 1;
+    const bool per_row = LUT && PixelWriter<O>::CHANNELS == 3;
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t *u = src + Mirror(y - 1, height) * src_step;
+        const uint8_t *c = src + y * src_step;
+        const uint8_t *d = src + Mirror(y + 1, height) * src_step;
+        uint8_t *out = dst + y * dst_step;
+        if (width < 4)
+        {
+            BorderColumns<O, per_pixel>(src, src_step, width, height, y, 0, width, rx, ry, out, lut);
+        }
+        // red rows carry red at parity rx, blue rows carry blue at parity rx ^ 1
+        else if ((y & 1) == ry)
+        {
+            const int x = per_pixel ? 2 : ROW<rx == 0, true, O>::Run(u, c, d, width, out);
+            ScalarRow<rx == 0, true, O, per_pixel>(u, c, d, x, width - 1, out, lut);
+        }
+        else
+        {
+            const int x = per_pixel ? 2 : ROW<rx == 1, false, O>::Run(u, c, d, width, out);
+            ScalarRow<rx == 1, false, O, per_pixel>(u, c, d, x, width - 1, out, lut);
+        }
+        if (width >= 4)
+        {
+            BorderColumns<O, per_pixel>(src, src_step, width, height, y, 0, 2, rx, ry, out, lut);
+            BorderColumns<O, per_pixel>(src, src_step, width, height, y, width - 1, width, rx, ry, out, lut);
+        }
+        if (per_row)
+        {
+            LutRow<O>(out, width, lut);
+        }
+    }
+}
+
+template <bool NATIVE_EVEN, bool RED_ROW, OutputEncoding O>
+struct NoVectorRow
+{
+    static int Run(const uint8_t *, const uint8_t *, const uint8_t *, int, uint8_t *) { return 2; }
+};
+
+// Preview: one pixel per 2x2 quad. RED_EVEN: red sits in the even column of its row.
+// rrow is the source row with red, brow the one with blue.
+template <bool RED_EVEN, OutputEncoding O, bool LUT>
+inline void ScalarQuads(const uint8_t *rrow, const uint8_t *brow, int x0, int x1, uint8_t *out, const ColorLut *lut)
+{
+    for (int x = x0; x < x1; ++x)
+    {
+        const uint8_t *r = rrow + 2 * x;
+        const uint8_t *b = brow + 2 * x;
+        const int g = (r[RED_EVEN ? 1 : 0] + b[RED_EVEN ? 0 : 1] + 1) >> 1;
+        Emit<O, LUT>(out + PixelWriter<O>::CHANNELS * x, r[RED_EVEN ? 0 : 1], g, b[RED_EVEN ? 1 : 0], lut);
+    }
+}
+
+template <BayerPattern P, OutputEncoding O, template <bool, OutputEncoding> class QUADS, bool LUT>
+void PreviewKernel(const uint8_t *src, size_t src_step, int width, int, uint8_t *dst, size_t dst_step, int y0, int y1,
+                   const ColorLut *lut)
+{
+    const bool red_even = PatternTraits<P>::RX == 0;
+    const bool per_pixel = LUT && PixelWriter<O>::CHANNELS == 1;
+    const bool per_row = LUT && PixelWriter<O>::CHANNELS == 3;
+    const int out_width = width / 2;
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t *top = src + 2 * y * src_step;
+        const uint8_t *rrow = PatternTraits<P>::RY == 0 ? top : top + src_step;
+        const uint8_t *brow = PatternTraits<P>::RY == 0 ? top + src_step : top;
+        uint8_t *out = dst + y * dst_step;
+        const int x = per_pixel ? 0 : QUADS<red_even, O>::Run(rrow, brow, out_width, out);
+        ScalarQuads<red_even, O, per_pixel>(rrow, brow, x, out_width, out, lut);
+        if (per_row)
+        {
+            LutRow<O>(out, out_width, lut);
+        }
+    }
+}
+
+template <bool RED_EVEN, OutputEncoding O>
+struct NoVectorQuads
+{
+    static int Run(const uint8_t *, const uint8_t *, int, uint8_t *) { return 0; }
+};
+
+#ifdef BAYER_KERNELS_X86
+// pshufb masks that interleave three 16-byte planes into 48 bytes of packed pixels:
+// output block k gets byte p of plane ch at position i when 16k + i == 3p + ch.
+// Spelled out as constants so the compiler keeps them in registers across the row loop.
+#define INTERLEAVE_BYTE(k, ch, i) (char)(((16 * (k) + (i)) % 3 == (ch)) ? (16 * (k) + (i)) / 3 : 0x80)
+#define INTERLEAVE_MASK(k, ch) \
+    INTERLEAVE_BYTE(k, ch, 0), INTERLEAVE_BYTE(k, ch, 1), INTERLEAVE_BYTE(k, ch, 2), INTERLEAVE_BYTE(k, ch, 3), \
+    INTERLEAVE_BYTE(k, ch, 4), INTERLEAVE_BYTE(k, ch, 5), INTERLEAVE_BYTE(k, ch, 6), INTERLEAVE_BYTE(k, ch, 7), \
+    INTERLEAVE_BYTE(k, ch, 8), INTERLEAVE_BYTE(k, ch, 9), INTERLEAVE_BYTE(k, ch, 10), INTERLEAVE_BYTE(k, ch, 11), \
+    INTERLEAVE_BYTE(k, ch, 12), INTERLEAVE_BYTE(k, ch, 13), INTERLEAVE_BYTE(k, ch, 14), INTERLEAVE_BYTE(k, ch, 15)
+
+__attribute__((target("ssse3")))
+inline __m128i InterleaveBlock(__m128i p0, __m128i p1, __m128i p2, __m128i m0, __m128i m1, __m128i m2)
+{
+    return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, m0), _mm_shuffle_epi8(p1, m1)), _mm_shuffle_epi8(p2, m2));
+}
+
+__attribute__((target("ssse3")))
+inline void Interleave16(__m128i p0, __m128i p1, __m128i p2, uint8_t *out)
+{
+    _mm_storeu_si128((__m128i *)out, InterleaveBlock(p0, p1, p2, _mm_setr_epi8(INTERLEAVE_MASK(0, 0)),
+                                                     _mm_setr_epi8(INTERLEAVE_MASK(0, 1)), _mm_setr_epi8(INTERLEAVE_MASK(0, 2))));
+    _mm_storeu_si128((__m128i *)(out + 16), InterleaveBlock(p0, p1, p2, _mm_setr_epi8(INTERLEAVE_MASK(1, 0)),
+                                                            _mm_setr_epi8(INTERLEAVE_MASK(1, 1)), _mm_setr_epi8(INTERLEAVE_MASK(1, 2))));
+    _mm_storeu_si128((__m128i *)(out + 32), InterleaveBlock(p0, p1, p2, _mm_setr_epi8(INTERLEAVE_MASK(2, 0)),
+                                                            _mm_setr_epi8(INTERLEAVE_MASK(2, 1)), _mm_setr_epi8(INTERLEAVE_MASK(2, 2))));
+}
+
+__attribute__((target("avx2")))
+inline __m256i InterleaveBlock256(__m256i p0, __m256i p1, __m256i p2, __m256i m0, __m256i m1, __m256i m2)
+{
+    return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(p0, m0), _mm256_shuffle_epi8(p1, m1)), _mm256_shuffle_epi8(p2, m2));
+}
+
+// same for 32 pixels: pshufb works per 128-bit lane, so each lane yields the three blocks
+// of its own 16 pixels, which are then put back in order across the lanes
+__attribute__((target("avx2")))
+inline void Interleave32(__m256i p0, __m256i p1, __m256i p2, uint8_t *out)
+{
+    __m256i block[3];
+    block[0] = InterleaveBlock256(p0, p1, p2, _mm256_setr_epi8(INTERLEAVE_MASK(0, 0), INTERLEAVE_MASK(0, 0)),
+                                  _mm256_setr_epi8(INTERLEAVE_MASK(0, 1), INTERLEAVE_MASK(0, 1)), _mm256_setr_epi8(INTERLEAVE_MASK(0, 2), INTERLEAVE_MASK(0, 2)));
+    block[1] = InterleaveBlock256(p0, p1, p2, _mm256_setr_epi8(INTERLEAVE_MASK(1, 0), INTERLEAVE_MASK(1, 0)),
+                                  _mm256_setr_epi8(INTERLEAVE_MASK(1, 1), INTERLEAVE_MASK(1, 1)), _mm256_setr_epi8(INTERLEAVE_MASK(1, 2), INTERLEAVE_MASK(1, 2)));
+    block[2] = InterleaveBlock256(p0, p1, p2, _mm256_setr_epi8(INTERLEAVE_MASK(2, 0), INTERLEAVE_MASK(2, 0)),
+                                  _mm256_setr_epi8(INTERLEAVE_MASK(2, 1), INTERLEAVE_MASK(2, 1)), _mm256_setr_epi8(INTERLEAVE_MASK(2, 2), INTERLEAVE_MASK(2, 2)));
+    _mm256_storeu_si256((__m256i *)out, _mm256_permute2x128_si256(block[0], block[1], 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 32), _mm256_permute2x128_si256(block[2], block[0], 0x30));
+    _mm256_storeu_si256((__m256i *)(out + 64), _mm256_permute2x128_si256(block[1], block[2], 0x31));
+}
+
+__attribute__((target("ssse3")))
+inline __m128i Select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// (a + b + c + d + 2) >> 2 per byte, in 16 bit
+__attribute__((target("ssse3")))
+inline __m128i Average4(__m128i a, __m128i b, __m128i c, __m128i d)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i two = _mm_set1_epi16(2);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+                               _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+                               _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+    lo = _mm_srli_epi16(_mm_add_epi16(lo, two), 2);
+    hi = _mm_srli_epi16(_mm_add_epi16(hi, two), 2);
+    return _mm_packus_epi16(lo, hi);
+}
+
+// (LUMA_R * r + LUMA_G * g + LUMA_B * b + 128) >> 8 per byte. The sum stays below 65536.
+__attribute__((target("ssse3")))
+inline __m128i Luma16(__m128i r, __m128i g, __m128i b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wr = _mm_set1_epi16(LUMA_R), wg = _mm_set1_epi16(LUMA_G), wb = _mm_set1_epi16(LUMA_B);
+    const __m128i half = _mm_set1_epi16(128);
+    __m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(r, zero), wr), _mm_mullo_epi16(_mm_unpacklo_epi8(g, zero), wg)),
+                               _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(b, zero), wb), half));
+    __m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(r, zero), wr), _mm_mullo_epi16(_mm_unpackhi_epi8(g, zero), wg)),
+                               _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(b, zero), wb), half));
+    return _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8));
+}
+
+__attribute__((target("avx2")))
+inline __m256i Select256(__m256i mask, __m256i a, __m256i b)
+{
+    return _mm256_or_si256(_mm256_and_si256(mask, a), _mm256_andnot_si256(mask, b));
+}
+
+// unpack and pack both work per 128-bit lane, so the byte order survives the round trip
+__attribute__((target("avx2")))
+inline __m256i Average4_256(__m256i a, __m256i b, __m256i c, __m256i d)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi16(2);
+    __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero)),
+                                  _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(d, zero)));
+    __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero)),
+                                  _mm256_add_epi16(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(d, zero)));
+    lo = _mm256_srli_epi16(_mm256_add_epi16(lo, two), 2);
+    hi = _mm256_srli_epi16(_mm256_add_epi16(hi, two), 2);
+    return _mm256_packus_epi16(lo, hi);
+}
+
+__attribute__((target("avx2")))
+inline __m256i Luma32(__m256i r, __m256i g, __m256i b)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wr = _mm256_set1_epi16(LUMA_R), wg = _mm256_set1_epi16(LUMA_G), wb = _mm256_set1_epi16(LUMA_B);
+    const __m256i half = _mm256_set1_epi16(128);
+    __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(r, zero), wr), _mm256_mullo_epi16(_mm256_unpacklo_epi8(g, zero), wg)),
+                                  _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(b, zero), wb), half));
+    __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(r, zero), wr), _mm256_mullo_epi16(_mm256_unpackhi_epi8(g, zero), wg)),
+                                  _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(b, zero), wb), half));
+    return _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8));
+}
+
+template <OutputEncoding O> struct Store16;
+template <> struct Store16<OUTPUT_RGB8>
+{
+    __attribute__((target("ssse3"))) static void Run(__m128i r, __m128i g, __m128i b, uint8_t *out) { Interleave16(r, g, b, out); }
+};
+template <> struct Store16<OUTPUT_BGR8>
+{
+    __attribute__((target("ssse3"))) static void Run(__m128i r, __m128i g, __m128i b, uint8_t *out) { Interleave16(b, g, r, out); }
+};
+template <> struct Store16<OUTPUT_MONO8>
+{
+    __attribute__((target("ssse3"))) static void Run(__m128i r, __m128i g, __m128i b, uint8_t *out) { _mm_storeu_si128((__m128i *)out, Luma16(r, g, b)); }
+};
+template <> struct Store16<OUTPUT_GREEN8>
+{
+    __attribute__((target("ssse3"))) static void Run(__m128i, __m128i g, __m128i, uint8_t *out) { _mm_storeu_si128((__m128i *)out, g); }
+};
+
+template <OutputEncoding O> struct Store32;
+template <> struct Store32<OUTPUT_RGB8>
+{
+    __attribute__((target("avx2"))) static void Run(__m256i r, __m256i g, __m256i b, uint8_t *out) { Interleave32(r, g, b, out); }
+};
+template <> struct Store32<OUTPUT_BGR8>
+{
+    __attribute__((target("avx2"))) static void Run(__m256i r, __m256i g, __m256i b, uint8_t *out) { Interleave32(b, g, r, out); }
+};
+template <> struct Store32<OUTPUT_MONO8>
+{
+    __attribute__((target("avx2"))) static void Run(__m256i r, __m256i g, __m256i b, uint8_t *out) { _mm256_storeu_si256((__m256i *)out, Luma32(r, g, b)); }
+};
+template <> struct Store32<OUTPUT_GREEN8>
+{
+    __attribute__((target("avx2"))) static void Run(__m256i, __m256i g, __m256i, uint8_t *out) { _mm256_storeu_si256((__m256i *)out, g); }
+};
+
+// 16 pixels per step from x = 2, so lane parity equals x parity
+template <bool NATIVE_EVEN, bool RED_ROW, OutputEncoding O>
+struct Ssse3Row
+{
+    __attribute__((target("ssse3")))
+    static int Run(const uint8_t *u, const uint8_t *c, const uint8_t *d, int width, uint8_t *out)
+    {
+        const __m128i native = _mm_set1_epi16(NATIVE_EVEN ? 0x00FF : (short)0xFF00);
+        int x = 2;
+        for (; x + 17 <= width; x += 16)
+        {
+            const __m128i cl = _mm_loadu_si128((const __m128i *)(c + x - 1));
+            const __m128i cc = _mm_loadu_si128((const __m128i *)(c + x));
+            const __m128i cr = _mm_loadu_si128((const __m128i *)(c + x + 1));
+            const __m128i uc = _mm_loadu_si128((const __m128i *)(u + x));
+            const __m128i dc = _mm_loadu_si128((const __m128i *)(d + x));
+
+            const __m128i h = _mm_avg_epu8(cl, cr);     // (a + b + 1) >> 1
+            const __m128i v = _mm_avg_epu8(uc, dc);
+            const __m128i cross = Average4(cl, cr, uc, dc);
+            const __m128i diag = Average4(_mm_loadu_si128((const __m128i *)(u + x - 1)), _mm_loadu_si128((const __m128i *)(u + x + 1)),
+                                          _mm_loadu_si128((const __m128i *)(d + x - 1)), _mm_loadu_si128((const __m128i *)(d + x + 1)));
+
+            const __m128i a = Select(native, cc, h);
+            const __m128i g = Select(native, cross, cc);
+            const __m128i z = Select(native, diag, v);
+            Store16<O>::Run(RED_ROW ? a : z, g, RED_ROW ? z : a, out + PixelWriter<O>::CHANNELS * x);
+        }
+        return x;
+    }
+};
+
+template <bool NATIVE_EVEN, bool RED_ROW, OutputEncoding O>
+struct Avx2Row
+{
+    __attribute__((target("avx2")))
+    static int Run(const uint8_t *u, const uint8_t *c, const uint8_t *d, int width, uint8_t *out)
+    {
+        const __m256i native = _mm256_set1_epi16(NATIVE_EVEN ? 0x00FF : (short)0xFF00);
+        int x = 2;
+        for (; x + 33 <= width; x += 32)
+        {
+            const __m256i cl = _mm256_loadu_si256((const __m256i *)(c + x - 1));
+            const __m256i cc = _mm256_loadu_si256((const __m256i *)(c + x));
+            const __m256i cr = _mm256_loadu_si256((const __m256i *)(c + x + 1));
+            const __m256i uc = _mm256_loadu_si256((const __m256i *)(u + x));
+            const __m256i dc = _mm256_loadu_si256((const __m256i *)(d + x));
+
+            const __m256i h = _mm256_avg_epu8(cl, cr);
+            const __m256i v = _mm256_avg_epu8(uc, dc);
+            const __m256i cross = Average4_256(cl, cr, uc, dc);
+            const __m256i diag = Average4_256(_mm256_loadu_si256((const __m256i *)(u + x - 1)), _mm256_loadu_si256((const __m256i *)(u + x + 1)),
+                                              _mm256_loadu_si256((const __m256i *)(d + x - 1)), _mm256_loadu_si256((const __m256i *)(d + x + 1)));
+
+            const __m256i a = Select256(native, cc, h);
+            const __m256i g = Select256(native, cross, cc);
+            const __m256i z = Select256(native, diag, v);
+            Store32<O>::Run(RED_ROW ? a : z, g, RED_ROW ? z : a, out + PixelWriter<O>::CHANNELS * x);
+        }
+        return x;
+    }
+};
+// 16 quads per step: split even and odd columns of both rows
+template <bool RED_EVEN, OutputEncoding O>
+struct Ssse3Quads
+{
+    __attribute__((target("ssse3")))
+    static int Run(const uint8_t *rrow, const uint8_t *brow, int out_width, uint8_t *out)
+    {
+        const __m128i low = _mm_set1_epi16(0x00FF);
+        int x = 0;
+        for (; x + 16 <= out_width; x += 16)
+        {
+            const __m128i r0 = _mm_loadu_si128((const __m128i *)(rrow + 2 * x));
+            const __m128i r1 = _mm_loadu_si128((const __m128i *)(rrow + 2 * x + 16));
+            const __m128i b0 = _mm_loadu_si128((const __m128i *)(brow + 2 * x));
+            const __m128i b1 = _mm_loadu_si128((const __m128i *)(brow + 2 * x + 16));
+            const __m128i r_even = _mm_packus_epi16(_mm_and_si128(r0, low), _mm_and_si128(r1, low));
+            const __m128i r_odd = _mm_packus_epi16(_mm_srli_epi16(r0, 8), _mm_srli_epi16(r1, 8));
+            const __m128i b_even = _mm_packus_epi16(_mm_and_si128(b0, low), _mm_and_si128(b1, low));
+            const __m128i b_odd = _mm_packus_epi16(_mm_srli_epi16(b0, 8), _mm_srli_epi16(b1, 8));
+            const __m128i g = _mm_avg_epu8(RED_EVEN ? r_odd : r_even, RED_EVEN ? b_even : b_odd);
+            Store16<O>::Run(RED_EVEN ? r_even : r_odd, g, RED_EVEN ? b_odd : b_even, out + PixelWriter<O>::CHANNELS * x);
+        }
+        return x;
+    }
+};
+
+// 32 quads per step. packus works per lane, the 64-bit permute puts the halves back in order.
+template <bool RED_EVEN, OutputEncoding O>
+struct Avx2Quads
+{
+    __attribute__((target("avx2")))
+    static int Run(const uint8_t *rrow, const uint8_t *brow, int out_width, uint8_t *out)
+    {
+        const __m256i low = _mm256_set1_epi16(0x00FF);
+        int x = 0;
+        for (; x + 32 <= out_width; x += 32)
+        {
+            const __m256i r0 = _mm256_loadu_si256((const __m256i *)(rrow + 2 * x));
+            const __m256i r1 = _mm256_loadu_si256((const __m256i *)(rrow + 2 * x + 32));
+            const __m256i b0 = _mm256_loadu_si256((const __m256i *)(brow + 2 * x));
+            const __m256i b1 = _mm256_loadu_si256((const __m256i *)(brow + 2 * x + 32));
+            const __m256i r_even = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(r0, low), _mm256_and_si256(r1, low)), 0xD8);
+            const __m256i r_odd = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(r0, 8), _mm256_srli_epi16(r1, 8)), 0xD8);
+            const __m256i b_even = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_and_si256(b0, low), _mm256_and_si256(b1, low)), 0xD8);
+            const __m256i b_odd = _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(b0, 8), _mm256_srli_epi16(b1, 8)), 0xD8);
+            const __m256i g = _mm256_avg_epu8(RED_EVEN ? r_odd : r_even, RED_EVEN ? b_even : b_odd);
+            Store32<O>::Run(RED_EVEN ? r_even : r_odd, g, RED_EVEN ? b_odd : b_even, out + PixelWriter<O>::CHANNELS * x);
+        }
+        return x;
+    }
+};
+#endif
+
+// table of every (pattern, encoding) instantiation of one row implementation
+template <template <bool, bool, OutputEncoding> class ROW, bool LUT = false>
+struct KernelTable
+{
+    ConvertKernel kernels[NUM_BAYER_PATTERNS][NUM_OUTPUT_ENCODINGS];
+    KernelTable()
+    {
+        Fill<BAYER_RG>();
+        Fill<BAYER_BG>();
+        Fill<BAYER_GB>();
+        Fill<BAYER_GR>();
+    }
+    template <BayerPattern P>
+    void Fill()
+    {
+        kernels[P][OUTPUT_RGB8] = RowsKernel<P, OUTPUT_RGB8, ROW, LUT>;
+        kernels[P][OUTPUT_BGR8] = RowsKernel<P, OUTPUT_BGR8, ROW, LUT>;
+        kernels[P][OUTPUT_MONO8] = RowsKernel<P, OUTPUT_MONO8, ROW, LUT>;
+        kernels[P][OUTPUT_GREEN8] = RowsKernel<P, OUTPUT_GREEN8, ROW, LUT>;
+    }
+};
+template <template <bool, OutputEncoding> class QUADS, bool LUT = false>
+struct PreviewTable
+{
+    ConvertKernel kernels[NUM_BAYER_PATTERNS][NUM_OUTPUT_ENCODINGS];
+    PreviewTable()
+    {
+        Fill<BAYER_RG>();
+        Fill<BAYER_BG>();
+        Fill<BAYER_GB>();
+        Fill<BAYER_GR>();
+    }
+    template <BayerPattern P>
+    void Fill()
+    {
+        kernels[P][OUTPUT_RGB8] = PreviewKernel<P, OUTPUT_RGB8, QUADS, LUT>;
+        kernels[P][OUTPUT_BGR8] = PreviewKernel<P, OUTPUT_BGR8, QUADS, LUT>;
+        kernels[P][OUTPUT_MONO8] = PreviewKernel<P, OUTPUT_MONO8, QUADS, LUT>;
+        kernels[P][OUTPUT_GREEN8] = PreviewKernel<P, OUTPUT_GREEN8, QUADS, LUT>;
+    }
+};
+}
+
+void DebayerReference(const uint8_t *src, size_t src_step, int width, int height,
+                      uint8_t *dst, size_t dst_step, int y0, int y1, BayerPattern pattern, OutputEncoding encoding,
+                      const ColorLut *lut)
+{
+    int rx, ry;
+    RedSite(pattern, rx, ry);
+    const int channels = OutputChannels(encoding);
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int x = 0; x < width; ++x)
+        {
+            int r, g, b;
+            DebayerPixel(src, src_step, width, height, x, y, rx, ry, r, g, b);
+            ReferenceWrite(dst + y * dst_step + channels * x, r, g, b, encoding, lut);
+        }
+    }
+}
+
+SimdLevel DetectSimdLevel()
+{
+#ifdef BAYER_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("ssse3"))
+    {
+        return SIMD_SSSE3;
+    }
+#endif
+    return SIMD_NONE;
+}
+
+const char *SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SIMD_AVX2:  return "AVX2";
+        case SIMD_SSSE3: return "SSSE3";
+        default:         return "scalar";
+    }
+}
+
+ConvertKernel SelectBayerKernel(BayerPattern pattern, OutputEncoding encoding, SimdLevel level, bool lut)
+{
+    static const KernelTable<NoVectorRow> scalar;
+    static const KernelTable<NoVectorRow, true> scalar_lut;
+#ifdef BAYER_KERNELS_X86
+    static const KernelTable<Ssse3Row> ssse3;
+    static const KernelTable<Ssse3Row, true> ssse3_lut;
+    static const KernelTable<Avx2Row> avx2;
+    static const KernelTable<Avx2Row, true> avx2_lut;
+    if (level >= SIMD_AVX2)
+    {
+        return lut ? avx2_lut.kernels[pattern][encoding] : avx2.kernels[pattern][encoding];
+    }
+    if (level >= SIMD_SSSE3)
+    {
+        return lut ? ssse3_lut.kernels[pattern][encoding] : ssse3.kernels[pattern][encoding];
+    }
+#endif
+    return lut ? scalar_lut.kernels[pattern][encoding] : scalar.kernels[pattern][encoding];
+}
+
+void PreviewReference(const uint8_t *src, size_t src_step, int width, int,
+                      uint8_t *dst, size_t dst_step, int y0, int y1, BayerPattern pattern, OutputEncoding encoding,
+                      const ColorLut *lut)
+{
+    int rx, ry;
+    RedSite(pattern, rx, ry);
+    const int channels = OutputChannels(encoding);
+    for (int y = y0; y < y1; ++y)
+    {
+        for (int x = 0; x < width / 2; ++x)
+        {
+            const int r = src[(2 * y + ry) * src_step + 2 * x + rx];
+            const int b = src[(2 * y + 1 - ry) * src_step + 2 * x + 1 - rx];
+            const int g = (src[(2 * y + ry) * src_step + 2 * x + 1 - rx] + src[(2 * y + 1 - ry) * src_step + 2 * x + rx] + 1) >> 1;
+            ReferenceWrite(dst + y * dst_step + channels * x, r, g, b, encoding, lut);
+        }
+    }
+}
+
+ConvertKernel SelectPreviewKernel(BayerPattern pattern, OutputEncoding encoding, SimdLevel level, bool lut)
+{
+    static const PreviewTable<NoVectorQuads> scalar;
+    static const PreviewTable<NoVectorQuads, true> scalar_lut;
+#ifdef BAYER_KERNELS_X86
+    static const PreviewTable<Ssse3Quads> ssse3;
+    static const PreviewTable<Ssse3Quads, true> ssse3_lut;
+    static const PreviewTable<Avx2Quads> avx2;
+    static const PreviewTable<Avx2Quads, true> avx2_lut;
+    if (level >= SIMD_AVX2)
+    {
+        return lut ? avx2_lut.kernels[pattern][encoding] : avx2.kernels[pattern][encoding];
+    }
+    if (level >= SIMD_SSSE3)
+    {
+        return lut ? ssse3_lut.kernels[pattern][encoding] : ssse3.kernels[pattern][encoding];
+    }
+#endif
+    return lut ? scalar_lut.kernels[pattern][encoding] : scalar.kernels[pattern][encoding];
+}
@@ -0,0 +1,70 @@
+/*=========================================================
+Cameras run together from one process: each has its own
+pipeline under its namespace, and one trigger topic plus
+the optional internal trigger generator fire all of them,
+paced by the slowest. avt_rig is this with any number of
+cameras, avt_stereo with two and pairing on top.
+===========================================================*/
+
+#include "avt_camera_streaming/CameraRig.h"
+#include <algorithm>
+#include <functional>
+#include "ros/console.h"
+
+CameraRig::CameraRig(ros::NodeHandle nh, ros::NodeHandle private_nh, const std::vector<std::string> &namespaces,
+                     const std::string &topic, bool camera_triggers)
+    : namespaces(namespaces), diagnostics(nh, private_nh.getNamespace())
+{
+    for (size_t i = 0; i < namespaces.size(); ++i)
+    {
+        cameras.push_back(std::unique_ptr<AVTCamera>(new AVTCamera(ros::NodeHandle(nh, namespaces[i]), ros::NodeHandle(private_nh, namespaces[i]), topic, camera_triggers)));
+    }
+    trigger.reset(new TriggerListener(nh, private_nh, std::bind(&CameraRig::TriggerImages, this)));
+    diagnostics.Add("trigger dispatch", trigger->dispatch);
+    diagnostics.Add("trigger latency", trigger->latency);
+    // ~trigger_rate: also fire from a clock of our own, independent of message latency; the ticks
+    // pass the listener's governor, so they and the topic's triggers never come too close together
+    generator.reset(new TriggerGenerator(private_nh, std::bind(&TriggerListener::Fire, trigger.get())));
+    if (generator->Enabled())
+    {
+        diagnostics.Add("trigger generator late", generator->late);
+        diagnostics.Add("trigger generator deviation", generator->deviation);
+    }
+}
+
+void CameraRig::StartAcquisition()
+{
+    // one trigger fires all cameras, so the slowest sets the pace
+    double min_period = 0;
+    for (size_t i = 0; i < cameras.size(); ++i)
+    {
+        cameras[i]->StartAcquisition();
+        min_period = std::max(min_period, cameras[i]->MinFramePeriod());
+    }
+    trigger->SetMinPeriod(min_period);
+    if (generator->Enabled() && min_period > 0 && generator->Rate() * min_period > 1.0)
+    {
+        ROS_WARN("trigger_rate %.2f Hz is faster than the cameras can take frames (%.2f frames/s), the governor holds ticks back",
+                 generator->Rate(), 1.0 / min_period);
+    }
+    generator->Start();
+}
+
+void CameraRig::StopAcquisition()
+{
+    generator->Stop();
+    generator->LogStats();
+    trigger->LogStats();
+    for (size_t i = 0; i < cameras.size(); ++i)
+    {
+        cameras[i]->StopAcquisition();
+    }
+}
+
+void CameraRig::TriggerImages()
+{
+    for (size_t i = 0; i < cameras.size(); ++i)
+    {
+        cameras[i]->TriggerImage();
+    }
+}
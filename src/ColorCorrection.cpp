@@ -0,0 +1,60 @@
+/*=========================================================
+ColorCorrection builds the white balance / gamma table
+that the conversion kernels apply while debayering.
+===========================================================*/
+
+#include "avt_camera_streaming/ColorCorrection.h"
+#include <algorithm>
+#include <cmath>
+
+ColorCorrection::ColorCorrection() : gamma(1.0)
+{
+    gains[0] = gains[1] = gains[2] = 1.0;
+    Configure(1.0, 12);
+}
+
+void ColorCorrection::Configure(double gamma_, int lut_bits)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    gamma = gamma_ > 0.0 ? gamma_ : 1.0;
+    const size_t size = (size_t)1 << (lut_bits > 8 ? 12 : 8);
+    curve.resize(size);
+    for (size_t i = 0; i < size; ++i)
+    {
+        curve[i] = (uint8_t)std::lround(255.0 * std::pow((double)i / (size - 1), 1.0 / gamma));
+    }
+    Rebuild();
+}
+
+void ColorCorrection::SetGains(double red, double green, double blue)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    gains[0] = std::max(0.0, red);
+    gains[1] = std::max(0.0, green);
+    gains[2] = std::max(0.0, blue);
+    Rebuild();
+}
+
+void ColorCorrection::Rebuild()
+{
+    if (gamma == 1.0 && gains[0] == 1.0 && gains[1] == 1.0 && gains[2] == 1.0)
+    {
+        // identity: the frames take the plain SIMD kernels
+        std::atomic_store(&lut, std::shared_ptr<const ColorLut>());
+        return;
+    }
+
+    std::shared_ptr<ColorLut> table = std::make_shared<ColorLut>();
+    uint8_t *channels[3] = { table->r, table->g, table->b };
+    const double top = (double)(curve.size() - 1);
+    for (int c = 0; c < 3; ++c)
+    {
+        for (int v = 0; v < 256; ++v)
+        {
+            // gain first, clipped at full scale, then the curve
+            const double x = std::min(1.0, v * gains[c] / 255.0);
+            channels[c][v] = curve[(size_t)std::lround(x * top)];
+        }
+    }
+    std::atomic_store(&lut, std::shared_ptr<const ColorLut>(table));
+}
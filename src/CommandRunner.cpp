@@ -0,0 +1,184 @@
+/*=========================================================
+Runs Vimba commands and feature writes and waits for their
+completion with a timeout, polling IsCommandDone with an
+exponential backoff instead of spinning on it. Optionally
+the wait happens on a completion thread, so e.g. a trigger
+returns as soon as the command is sent. Keeps a latency
+histogram per command.
+===========================================================*/
+
+#include "avt_camera_streaming/CommandRunner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "ros/ros.h"
+#include "ros/console.h"
+
+// Every IsCommandDone is a round trip to the camera. The first poll goes out at once, most
+// commands are done by then; after that the gaps double up to the last value.
+static const uint64_t FIRST_BACKOFF_NS = 20000;
+static const uint64_t MAX_BACKOFF_NS = 5000000;
+
+CommandRunner::CommandRunner(double timeout_s) : timeout_ns((uint64_t)(timeout_s * 1e9)), running(true), pending_command(NULL),
+    pending_start_ns(0), superseded(0)
+{
+    thread = std::thread(&CommandRunner::Complete, this);
+}
+
+CommandRunner::~CommandRunner()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+uint64_t CommandRunner::NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CommandRunner::Command &CommandRunner::Find(const char *name)
+{
+    std::lock_guard<std::mutex> lock(commands_mutex);
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        if (commands[i]->name == name || std::strcmp(commands[i]->name, name) == 0)
+        {
+            return *commands[i];
+        }
+    }
+    commands.push_back(std::unique_ptr<Command>(new Command(name)));
+    return *commands.back();
+}
+
+VmbErrorType CommandRunner::Run(const AVT::VmbAPI::FeaturePtr &feature, const char *name)
+{
+    const uint64_t start_ns = NowNs();
+    Command &command = Find(name);
+    VmbErrorType err = feature->RunCommand();
+    if (VmbErrorSuccess != err)
+    {
+        command.failures.fetch_add(1, std::memory_order_relaxed);
+        return err;
+    }
+    return Wait(feature, command, start_ns);
+}
+
+VmbErrorType CommandRunner::RunAsync(const AVT::VmbAPI::FeaturePtr &feature, const char *name)
+{
+    const uint64_t start_ns = NowNs();
+    Command &command = Find(name);
+    VmbErrorType err = feature->RunCommand();
+    if (VmbErrorSuccess != err)
+    {
+        command.failures.fetch_add(1, std::memory_order_relaxed);
+        return err;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending)
+        {
+            superseded.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending = feature;
+        pending_command = &command;
+        pending_start_ns = start_ns;
+    }
+    wake.notify_one();
+    return VmbErrorSuccess;
+}
+
+VmbErrorType CommandRunner::Wait(const AVT::VmbAPI::FeaturePtr &feature, Command &command, uint64_t start_ns)
+{
+    uint64_t backoff_ns = FIRST_BACKOFF_NS;
+    for (;;)
+    {
+        bool done = false;
+        if (VmbErrorSuccess != feature->IsCommandDone(done))
+        {
+            // not a command, or the camera cannot tell: nothing to wait for
+            done = true;
+        }
+        const uint64_t now = NowNs();
+        const uint64_t elapsed_ns = now - start_ns;
+        if (done)
+        {
+            command.latency.Add(elapsed_ns);
+            command.completed.fetch_add(1, std::memory_order_relaxed);
+            command.total_ns.fetch_add(elapsed_ns, std::memory_order_relaxed);
+            uint64_t seen = command.max_ns.load(std::memory_order_relaxed);
+            while (elapsed_ns > seen && !command.max_ns.compare_exchange_weak(seen, elapsed_ns, std::memory_order_relaxed))
+            {
+            }
+            return VmbErrorSuccess;
+        }
+        const uint64_t limit_ns = timeout_ns.load(std::memory_order_relaxed);
+        if (elapsed_ns >= limit_ns)
+        {
+            command.timeouts.fetch_add(1, std::memory_order_relaxed);
+            ROS_ERROR_THROTTLE(5.0, "%s: not done after %.0f ms, giving up", command.name, elapsed_ns / 1e6);
+            return VmbErrorTimeout;
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(std::min(backoff_ns, limit_ns - elapsed_ns)));
+        backoff_ns = std::min(backoff_ns * 2, MAX_BACKOFF_NS);
+    }
+}
+
+void CommandRunner::Complete()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return !running || pending; });
+        if (!running)
+        {
+            break;
+        }
+        AVT::VmbAPI::FeaturePtr feature = pending;
+        pending.reset();
+        Command *command = pending_command;
+        const uint64_t start_ns = pending_start_ns;
+        lock.unlock();
+        Wait(feature, *command, start_ns);
+        lock.lock();
+    }
+}
+
+std::vector<CommandStats> CommandRunner::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(commands_mutex);
+    std::vector<CommandStats> stats;
+    for (size_t i = 0; i < commands.size(); ++i)
+    {
+        const Command &command = *commands[i];
+        CommandStats entry;
+        entry.name = command.name;
+        entry.completed = command.completed.load(std::memory_order_relaxed);
+        entry.total_ns = command.total_ns.load(std::memory_order_relaxed);
+        entry.max_ns = command.max_ns.load(std::memory_order_relaxed);
+        entry.timeouts = command.timeouts.load(std::memory_order_relaxed);
+        entry.failures = command.failures.load(std::memory_order_relaxed);
+        stats.push_back(entry);
+    }
+    return stats;
+}
+
+void CommandRunner::LogStats() const
+{
+    std::vector<CommandStats> stats = GetStats();
+    for (size_t i = 0; i < stats.size(); ++i)
+    {
+        const CommandStats &c = stats[i];
+        ROS_INFO("command %s: %llu done, mean %.3f ms, max %.3f ms, %llu timed out, %llu failed", c.name,
+                 (unsigned long long)c.completed, c.completed ? c.total_ns / 1e6 / c.completed : 0.0, c.max_ns / 1e6,
+                 (unsigned long long)c.timeouts, (unsigned long long)c.failures);
+    }
+    const uint64_t skipped = superseded.load(std::memory_order_relaxed);
+    if (skipped)
+    {
+        ROS_INFO("commands: %llu sent before the previous one was reported done, not waited for", (unsigned long long)skipped);
+    }
+}
@@ -0,0 +1,132 @@
+/*=========================================================
+ConversionTable maps a camera pixel format and an output
+encoding to the specialized conversion kernel.
+===========================================================*/
+
+#include "avt_camera_streaming/ConversionTable.h"
+#include <cstring>
+
+namespace
+{
+// Mono8 frames need no interpolation: copy, or replicate into all three channels.
+// A mono sensor has no white balance, only the gamma of the green table applies.
+template <int CHANNELS, bool LUT>
+void MonoKernel(const uint8_t *src, size_t src_step, int width, int, uint8_t *dst, size_t dst_step, int y0, int y1,
+                const ColorLut *lut)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t *in = src + y * src_step;
+        uint8_t *out = dst + y * dst_step;
+        if (CHANNELS == 1 && !LUT)
+        {
+            std::memcpy(out, in, width);
+            continue;
+        }
+        for (int x = 0; x < width; ++x)
+        {
+            const uint8_t value = LUT ? lut->g[in[x]] : in[x];
+            for (int c = 0; c < CHANNELS; ++c)
+            {
+                out[CHANNELS * x + c] = value;
+            }
+        }
+    }
+}
+
+// preview of a Mono8 frame: the rounded mean of each 2x2 block
+template <int CHANNELS, bool LUT>
+void MonoPreview(const uint8_t *src, size_t src_step, int width, int, uint8_t *dst, size_t dst_step, int y0, int y1,
+                 const ColorLut *lut)
+{
+    for (int y = y0; y < y1; ++y)
+    {
+        const uint8_t *top = src + 2 * y * src_step;
+        const uint8_t *bottom = top + src_step;
+        uint8_t *out = dst + y * dst_step;
+        for (int x = 0; x < width / 2; ++x)
+        {
+            const int mean = (top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 2) >> 2;
+            const uint8_t value = LUT ? lut->g[mean] : (uint8_t)mean;
+            for (int c = 0; c < CHANNELS; ++c)
+            {
+                out[CHANNELS * x + c] = value;
+            }
+        }
+    }
+}
+}
+
+bool ParseOutputEncoding(const std::string &name, OutputEncoding &encoding)
+{
+    for (int e = 0; e < NUM_OUTPUT_ENCODINGS; ++e)
+    {
+        if (name == EncodingName((OutputEncoding)e))
+        {
+            encoding = (OutputEncoding)e;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *EncodingName(OutputEncoding encoding)
+{
+    switch (encoding)
+    {
+        case OUTPUT_RGB8:  return "rgb8";
+        case OUTPUT_BGR8:  return "bgr8";
+        default:           return "mono8";   // OUTPUT_MONO8 and OUTPUT_GREEN8
+    }
+}
+
+ConversionTable::ConversionTable(SimdLevel level)
+{
+    for (int e = 0; e < NUM_OUTPUT_ENCODINGS; ++e)
+    {
+        const OutputEncoding encoding = (OutputEncoding)e;
+        for (int l = 0; l < 2; ++l)
+        {
+            const bool lut = l != 0;
+            kernels[INPUT_BAYER_RG][e][l] = SelectBayerKernel(BAYER_RG, encoding, level, lut);
+            kernels[INPUT_BAYER_BG][e][l] = SelectBayerKernel(BAYER_BG, encoding, level, lut);
+            kernels[INPUT_BAYER_GB][e][l] = SelectBayerKernel(BAYER_GB, encoding, level, lut);
+            kernels[INPUT_BAYER_GR][e][l] = SelectBayerKernel(BAYER_GR, encoding, level, lut);
+
+            previews[INPUT_BAYER_RG][e][l] = SelectPreviewKernel(BAYER_RG, encoding, level, lut);
+            previews[INPUT_BAYER_BG][e][l] = SelectPreviewKernel(BAYER_BG, encoding, level, lut);
+            previews[INPUT_BAYER_GB][e][l] = SelectPreviewKernel(BAYER_GB, encoding, level, lut);
+            previews[INPUT_BAYER_GR][e][l] = SelectPreviewKernel(BAYER_GR, encoding, level, lut);
+        }
+        const bool mono = OutputChannels(encoding) == 1;
+        kernels[INPUT_MONO8][e][0] = mono ? MonoKernel<1, false> : MonoKernel<3, false>;
+        kernels[INPUT_MONO8][e][1] = mono ? MonoKernel<1, true> : MonoKernel<3, true>;
+        previews[INPUT_MONO8][e][0] = mono ? MonoPreview<1, false> : MonoPreview<3, false>;
+        previews[INPUT_MONO8][e][1] = mono ? MonoPreview<1, true> : MonoPreview<3, true>;
+    }
+}
+
+ConversionTable::Input ConversionTable::InputOf(VmbPixelFormatType format)
+{
+    switch (format)
+    {
+        case VmbPixelFormatBayerRG8: return INPUT_BAYER_RG;
+        case VmbPixelFormatBayerBG8: return INPUT_BAYER_BG;
+        case VmbPixelFormatBayerGB8: return INPUT_BAYER_GB;
+        case VmbPixelFormatBayerGR8: return INPUT_BAYER_GR;
+        case VmbPixelFormatMono8:    return INPUT_MONO8;
+        default:                     return NUM_INPUTS;
+    }
+}
+
+ConvertKernel ConversionTable::Find(VmbPixelFormatType format, OutputEncoding encoding, bool lut) const
+{
+    const Input input = InputOf(format);
+    return input == NUM_INPUTS ? NULL : kernels[input][encoding][lut ? 1 : 0];
+}
+
+ConvertKernel ConversionTable::FindPreview(VmbPixelFormatType format, OutputEncoding encoding, bool lut) const
+{
+    const Input input = InputOf(format);
+    return input == NUM_INPUTS ? NULL : previews[input][encoding][lut ? 1 : 0];
+}
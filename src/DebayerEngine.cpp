@@ -0,0 +1,27 @@
+/*=========================================================
+DebayerEngine converts a Bayer frame in horizontal bands
+on the shared ThreadPool.
+===========================================================*/
+
+#include "avt_camera_streaming/DebayerEngine.h"
+#include <algorithm>
+
+DebayerEngine::DebayerEngine(ThreadPool &pool, int bands_per_thread) : pool(pool), bands_per_thread(std::max(1, bands_per_thread))
+{
+}
+
+void DebayerEngine::Convert(const cv::Mat &src, cv::Mat &dst, ConvertKernel kernel, const ColorLut *lut)
+{
+    const int rows = dst.rows;
+    // keep bands at a few dozen rows at least, below that the hand-off costs more than it saves
+    int bands = std::max(1, std::min(pool.ThreadCount() * bands_per_thread, rows / 16));
+    const int band_rows = (rows + bands - 1) / bands;
+    bands = (rows + band_rows - 1) / band_rows;
+
+    pool.ParallelFor(bands, [&](size_t band)
+    {
+        const int y0 = (int)band * band_rows;
+        const int y1 = std::min(rows, y0 + band_rows);
+        kernel(src.data, src.step, src.cols, src.rows, dst.data, dst.step, y0, y1, lut);
+    });
+}
@@ -0,0 +1,177 @@
+/*=========================================================
+One block of page-aligned memory, reserved at startup, that
+the frame pools of every camera in the process take their
+buffers from. Its size is a hard ceiling: a pool sizes
+itself to what still fits, and a camera that cannot get
+even the fewest buffers it needs does not start.
+===========================================================*/
+
+#include "avt_camera_streaming/FrameArena.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "ros/ros.h"
+#include "ros/console.h"
+
+// buffers live as long as an acquisition and there are a few per camera
+static const size_t RESERVED_BLOCKS = 64;
+
+FrameArena &FrameArena::Shared()
+{
+    static FrameArena arena;
+    return arena;
+}
+
+FrameArena::FrameArena() : base(NULL), page_size(sysconf(_SC_PAGESIZE)), stats()
+{
+}
+
+FrameArena::~FrameArena()
+{
+    if (base)
+    {
+        munmap(base, stats.ceiling);
+    }
+}
+
+bool FrameArena::Reserve(size_t ceiling)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (base)
+    {
+        if ((ceiling + page_size - 1) / page_size * page_size != stats.ceiling)
+        {
+            ROS_WARN("frame arena: already reserved with %.1f MB, ignoring %.1f MB", stats.ceiling / 1048576.0, ceiling / 1048576.0);
+        }
+        return true;
+    }
+    if (ceiling == 0)
+    {
+        return false;
+    }
+    ceiling = (ceiling + page_size - 1) / page_size * page_size;
+    // MAP_POPULATE faults every page in now: the arena is resident, and counted in RSS, from the start
+    void *memory = mmap(NULL, ceiling, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        ROS_ERROR("frame arena: cannot map %.1f MB: %s", ceiling / 1048576.0, std::strerror(errno));
+        return false;
+    }
+    base = static_cast<unsigned char*>(memory);
+    stats.ceiling = ceiling;
+    // not fatal: without CAP_IPC_LOCK or a large enough RLIMIT_MEMLOCK the pages could only be swapped out
+    stats.locked = mlock(base, ceiling) == 0;
+    if (!stats.locked)
+    {
+        ROS_WARN("frame arena: cannot lock the pages in RAM (%s), check ulimit -l", std::strerror(errno));
+    }
+    blocks.reserve(RESERVED_BLOCKS);
+    Block all = { 0, ceiling, false };
+    blocks.push_back(all);
+    ROS_INFO("frame arena: %.1f MB reserved%s", ceiling / 1048576.0, stats.locked ? " and locked" : "");
+    return true;
+}
+
+unsigned char *FrameArena::Allocate(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!base || bytes == 0)
+    {
+        return NULL;
+    }
+    const size_t size = (bytes + page_size - 1) / page_size * page_size;
+    // first fit: buffers come and go together with acquisitions, the arena does not fragment much
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        if (blocks[i].used || blocks[i].size < size)
+        {
+            continue;
+        }
+        if (blocks[i].size > size)
+        {
+            Block rest = { blocks[i].offset + size, blocks[i].size - size, false };
+            blocks.insert(blocks.begin() + i + 1, rest);
+            blocks[i].size = size;
+        }
+        blocks[i].used = true;
+        stats.used += size;
+        stats.blocks++;
+        if (stats.used > stats.peak)
+        {
+            stats.peak = stats.used;
+        }
+        return base + blocks[i].offset;
+    }
+    stats.refused++;
+    return NULL;
+}
+
+size_t FrameArena::Fits(size_t bytes) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!base || bytes == 0)
+    {
+        return 0;
+    }
+    const size_t size = (bytes + page_size - 1) / page_size * page_size;
+    // first fit fills each free block before the next, so the free blocks count separately
+    size_t fits = 0;
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        if (!blocks[i].used)
+        {
+            fits += blocks[i].size / size;
+        }
+    }
+    return fits;
+}
+
+void FrameArena::Free(unsigned char *buffer)
+{
+    if (!buffer)
+    {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < blocks.size(); ++i)
+    {
+        if (base + blocks[i].offset != buffer || !blocks[i].used)
+        {
+            continue;
+        }
+        blocks[i].used = false;
+        stats.used -= blocks[i].size;
+        stats.blocks--;
+        if (i + 1 < blocks.size() && !blocks[i + 1].used)
+        {
+            blocks[i].size += blocks[i + 1].size;
+            blocks.erase(blocks.begin() + i + 1);
+        }
+        if (i > 0 && !blocks[i - 1].used)
+        {
+            blocks[i - 1].size += blocks[i].size;
+            blocks.erase(blocks.begin() + i);
+        }
+        return;
+    }
+    ROS_ERROR("frame arena: %p is not a buffer of the arena", (void*)buffer);
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void FrameArena::LogStats() const
+{
+    FrameArenaStats current = GetStats();
+    if (current.ceiling == 0)
+    {
+        return;
+    }
+    ROS_INFO("frame arena: %.1f of %.1f MB in %zu buffers, peak %.1f MB, %llu buffers refused at the ceiling",
+             current.used / 1048576.0, current.ceiling / 1048576.0, current.blocks, current.peak / 1048576.0,
+             (unsigned long long)current.refused);
+}
@@ -0,0 +1,412 @@
+/*=========================================================
+FramePool owns the frame buffers announced to the camera.
+It sizes itself from the measured processing time and
+records, per buffer, how long it spends in our code and how
+long in the capture queue. Delivered frames are handed out
+as FrameLease, which re-queues them exactly once.
+===========================================================*/
+
+#include "avt_camera_streaming/FramePool.h"
+#include "avt_camera_streaming/FrameArena.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "ros/ros.h"
+#include "ros/console.h"
+
+const size_t FramePool::MIN_DEPTH;
+const size_t FramePool::MAX_DEPTH;
+const size_t FramePool::DEFAULT_DEPTH;
+
+namespace
+{
+uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void UpdateMax(std::atomic<uint64_t> &max, uint64_t value)
+{
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while (value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+// 0 means no value yet
+void UpdateMin(std::atomic<uint64_t> &min, uint64_t value)
+{
+    uint64_t seen = min.load(std::memory_order_relaxed);
+    while ((seen == 0 || value < seen) && !min.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+    {
+    }
+}
+}
+
+FrameLease::FrameLease(FrameLease &&other) : pool(other.pool), frame(other.frame)
+{
+    other.pool = NULL;
+    other.frame.reset();
+}
+
+FrameLease &FrameLease::operator=(FrameLease &&other)
+{
+    if (this != &other)
+    {
+        Requeue();
+        pool = other.pool;
+        frame = other.frame;
+        other.pool = NULL;
+        other.frame.reset();
+    }
+    return *this;
+}
+
+uint64_t FrameLease::DeliveredNs() const
+{
+    FramePool::Slot *slot = pool ? pool->FindSlot(frame) : NULL;
+    return slot ? slot->delivered_at_ns.load(std::memory_order_relaxed) : 0;
+}
+
+void FrameLease::Requeue()
+{
+    if (pool)
+    {
+        FramePool *owner = pool;
+        pool = NULL;
+        owner->Queue(frame);
+        frame.reset();
+    }
+}
+
+FramePool::FramePool() : requested_depth(0), frame_rate(0), queued(0), delivered(0), starvation_events(0), starved_since_ns(0), starved_ns(0),
+    frames_lost(0), frames_lost_while_starved(0), duplicate_queues(0), first_delivery_ns(0), last_delivery_ns(0), reported_starvation_events(0),
+    have_frame_id(false), last_frame_id(0), starved_since_last_delivery(false)
+{
+}
+
+FramePool::~FramePool()
+{
+    FreeBuffers();
+}
+
+size_t FramePool::SuggestDepth() const
+{
+    if (requested_depth > 0)
+    {
+        return requested_depth;
+    }
+    FramePoolStats stats = GetStats();
+    uint64_t worst_out_ns = 0;
+    for (size_t i = 0; i < stats.buffers.size(); ++i)
+    {
+        worst_out_ns = std::max(worst_out_ns, stats.buffers[i].max_out_ns);
+    }
+    // frames can arrive as fast as the configured rate, or faster if we measured that
+    double period = frame_rate > 0 ? 1.0 / frame_rate : 0;
+    if (stats.mean_interval_s > 0 && (period == 0 || stats.mean_interval_s < period))
+    {
+        period = stats.mean_interval_s;
+    }
+    if (worst_out_ns == 0 || period == 0)
+    {
+        return DEFAULT_DEPTH;
+    }
+    // one buffer being filled by the camera plus enough to cover the slowest turnaround
+    size_t depth = (size_t)std::ceil(worst_out_ns * 1e-9 / period) + 1;
+    return std::min(std::max(depth, MIN_DEPTH), MAX_DEPTH);
+}
+
+bool FramePool::Announce(const AVT::VmbAPI::CameraPtr &pCamera, VmbInt64_t payload_size, const AVT::VmbAPI::IFrameObserverPtr &pObserver, double fps)
+{
+    // size from the previous acquisition before its numbers are cleared
+    frame_rate = fps;
+    size_t depth = SuggestDepth();
+
+    const size_t previous_depth = slots.size();
+
+    camera = pCamera;
+    FreeBuffers();
+    slots.clear();
+    FrameArena &arena = FrameArena::Shared();
+    if (arena.Reserved())
+    {
+        // the ceiling holds: fewer buffers, never memory from elsewhere
+        const size_t fits = arena.Fits(payload_size);
+        const size_t needed = requested_depth > 0 ? depth : MIN_DEPTH;
+        if (fits < needed)
+        {
+            ROS_ERROR("frame pool: %zu buffers of %.1f MB do not fit in the frame arena (room for %zu), raise frame_arena_mb",
+                      needed, payload_size / 1048576.0, fits);
+            ResetCounters();
+            return false;
+        }
+        if (depth > fits)
+        {
+            ROS_WARN("frame pool: only %zu of %zu buffers fit in the frame arena, raise frame_arena_mb", fits, depth);
+            depth = fits;
+        }
+    }
+    if (depth != previous_depth)
+    {
+        ROS_INFO("frame pool: using %zu buffers (%s)", depth, requested_depth > 0 ? "num_frames" : "auto");
+    }
+
+    for (size_t i = 0; i < depth; ++i)
+    {
+        std::unique_ptr<Slot> slot(new Slot);
+        slot->buffer = NULL;
+        if (arena.Reserved())
+        {
+            // Vimba fills our buffer and neither allocates nor frees it
+            slot->buffer = arena.Allocate(payload_size);
+            if (!slot->buffer)
+            {
+                // another camera of the process took the room since Fits()
+                ROS_ERROR("frame pool: the frame arena filled up while announcing, raise frame_arena_mb");
+                break;
+            }
+        }
+        slots.push_back(std::move(slot));
+    }
+    if (slots.size() < depth)
+    {
+        FreeBuffers();
+        slots.clear();
+        ResetCounters();
+        return false;
+    }
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        Slot &slot = *slots[i];
+        if (slot.buffer)
+        {
+            slot.frame.reset(new AVT::VmbAPI::Frame(slot.buffer, payload_size));
+        }
+        else
+        {
+            slot.frame.reset(new AVT::VmbAPI::Frame(payload_size));
+        }
+        slot.frame->RegisterObserver(pObserver);
+        camera->AnnounceFrame(slot.frame);
+    }
+    ResetCounters();
+    return true;
+}
+
+void FramePool::QueueAll()
+{
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        Queue(slots[i]->frame);
+    }
+}
+
+void FramePool::Release()
+{
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        // Unregister the frame observer / callback
+        slots[i]->frame->UnregisterObserver();
+    }
+    // the frames are revoked, the camera no longer writes to them
+    FreeBuffers();
+    LogStats();
+    ROS_INFO("frame pool: next acquisition would use %zu buffers", SuggestDepth());
+}
+
+void FramePool::FreeBuffers()
+{
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        FrameArena::Shared().Free(slots[i]->buffer);
+        slots[i]->buffer = NULL;
+    }
+}
+
+void FramePool::ResetCounters()
+{
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        slots[i]->out = true;   // announced buffers are ours until QueueAll()
+        slots[i]->delivered_at_ns = 0;
+        slots[i]->queued_at_ns = 0;
+        slots[i]->deliveries = 0;
+        slots[i]->total_out_ns = 0;
+        slots[i]->max_out_ns = 0;
+        slots[i]->fills = 0;
+        slots[i]->total_queued_ns = 0;
+        slots[i]->min_queued_ns = 0;
+    }
+    queued = 0;
+    delivered = 0;
+    starvation_events = 0;
+    starved_since_ns = 0;
+    starved_ns = 0;
+    frames_lost = 0;
+    frames_lost_while_starved = 0;
+    duplicate_queues = 0;
+    first_delivery_ns = 0;
+    last_delivery_ns = 0;
+    reported_starvation_events = 0;
+    have_frame_id = false;
+    starved_since_last_delivery = false;
+}
+
+FramePool::Slot *FramePool::FindSlot(const AVT::VmbAPI::FramePtr &pFrame)
+{
+    // a handful of buffers, a linear scan beats hashing
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        if (SP_ISEQUAL(slots[i]->frame, pFrame))
+        {
+            return slots[i].get();
+        }
+    }
+    return NULL;
+}
+
+void FramePool::OnFrameDelivered(const AVT::VmbAPI::FramePtr &pFrame)
+{
+    uint64_t now = NowNs();
+    Slot *slot = FindSlot(pFrame);
+    if (slot)
+    {
+        slot->out.store(true, std::memory_order_relaxed);
+        slot->delivered_at_ns.store(now, std::memory_order_relaxed);
+        uint64_t since = slot->queued_at_ns.exchange(0, std::memory_order_relaxed);
+        if (since)
+        {
+            uint64_t queued_ns = now - since;
+            slot->fills.fetch_add(1, std::memory_order_relaxed);
+            slot->total_queued_ns.fetch_add(queued_ns, std::memory_order_relaxed);
+            UpdateMin(slot->min_queued_ns, queued_ns);
+        }
+    }
+    if (delivered.fetch_add(1, std::memory_order_relaxed) == 0)
+    {
+        first_delivery_ns.store(now, std::memory_order_relaxed);
+    }
+    last_delivery_ns.store(now, std::memory_order_relaxed);
+
+    VmbUint64_t frame_id;
+    if (VmbErrorSuccess == pFrame->GetFrameID(frame_id))
+    {
+        if (have_frame_id && frame_id > last_frame_id + 1)
+        {
+            uint64_t missing = frame_id - last_frame_id - 1;
+            frames_lost.fetch_add(missing, std::memory_order_relaxed);
+            if (starved_since_last_delivery)
+            {
+                frames_lost_while_starved.fetch_add(missing, std::memory_order_relaxed);
+            }
+        }
+        have_frame_id = true;
+        last_frame_id = frame_id;
+    }
+
+    starved_since_last_delivery = false;
+    if (queued.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        // that was the last queued buffer: until something is re-queued the camera has nowhere to put a frame
+        starved_since_ns.store(now, std::memory_order_relaxed);
+        starvation_events.fetch_add(1, std::memory_order_relaxed);
+        starved_since_last_delivery = true;
+    }
+}
+
+FrameLease FramePool::Lease(const AVT::VmbAPI::FramePtr &pFrame)
+{
+    OnFrameDelivered(pFrame);
+    return FrameLease(this, pFrame);
+}
+
+void FramePool::Queue(const AVT::VmbAPI::FramePtr &pFrame)
+{
+    uint64_t now = NowNs();
+    Slot *slot = FindSlot(pFrame);
+    if (slot)
+    {
+        if (!slot->out.exchange(false, std::memory_order_relaxed))
+        {
+            // the camera has it already, a second QueueFrame would only fail inside Vimba
+            duplicate_queues.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        slot->queued_at_ns.store(now, std::memory_order_relaxed);
+        uint64_t since = slot->delivered_at_ns.exchange(0, std::memory_order_relaxed);
+        if (since)
+        {
+            uint64_t out_ns = now - since;
+            slot->deliveries.fetch_add(1, std::memory_order_relaxed);
+            slot->total_out_ns.fetch_add(out_ns, std::memory_order_relaxed);
+            UpdateMax(slot->max_out_ns, out_ns);
+        }
+    }
+    if (queued.fetch_add(1, std::memory_order_acq_rel) == 0)
+    {
+        uint64_t since = starved_since_ns.exchange(0, std::memory_order_relaxed);
+        if (since)
+        {
+            starved_ns.fetch_add(now - since, std::memory_order_relaxed);
+        }
+    }
+    camera->QueueFrame(pFrame);
+}
+
+FramePoolStats FramePool::GetStats() const
+{
+    FramePoolStats stats;
+    stats.depth = slots.size();
+    stats.delivered = delivered.load(std::memory_order_relaxed);
+    stats.starvation_events = starvation_events.load(std::memory_order_relaxed);
+    stats.starved_ns = starved_ns.load(std::memory_order_relaxed);
+    stats.frames_lost = frames_lost.load(std::memory_order_relaxed);
+    stats.frames_lost_while_starved = frames_lost_while_starved.load(std::memory_order_relaxed);
+    stats.duplicate_queues = duplicate_queues.load(std::memory_order_relaxed);
+    stats.mean_interval_s = 0;
+    if (stats.delivered > 1)
+    {
+        stats.mean_interval_s = (last_delivery_ns.load(std::memory_order_relaxed) - first_delivery_ns.load(std::memory_order_relaxed)) * 1e-9 / (stats.delivered - 1);
+    }
+    for (size_t i = 0; i < slots.size(); ++i)
+    {
+        FrameBufferStats buffer;
+        buffer.deliveries = slots[i]->deliveries.load(std::memory_order_relaxed);
+        buffer.total_out_ns = slots[i]->total_out_ns.load(std::memory_order_relaxed);
+        buffer.max_out_ns = slots[i]->max_out_ns.load(std::memory_order_relaxed);
+        buffer.fills = slots[i]->fills.load(std::memory_order_relaxed);
+        buffer.total_queued_ns = slots[i]->total_queued_ns.load(std::memory_order_relaxed);
+        buffer.min_queued_ns = slots[i]->min_queued_ns.load(std::memory_order_relaxed);
+        stats.buffers.push_back(buffer);
+    }
+    return stats;
+}
+
+void FramePool::LogStats() const
+{
+    FramePoolStats stats = GetStats();
+    ROS_INFO("frame pool: %zu buffers, %llu frames delivered, %llu lost (%llu while no buffer was queued)",
+             stats.depth, (unsigned long long)stats.delivered, (unsigned long long)stats.frames_lost,
+             (unsigned long long)stats.frames_lost_while_starved);
+    ROS_INFO("frame pool: %llu starvation events, %.1f ms without a queued buffer, %llu duplicate re-queues skipped",
+             (unsigned long long)stats.starvation_events, stats.starved_ns / 1e6, (unsigned long long)stats.duplicate_queues);
+    for (size_t i = 0; i < stats.buffers.size(); ++i)
+    {
+        const FrameBufferStats &b = stats.buffers[i];
+        ROS_INFO("frame pool: buffer %zu: %llu deliveries, in user code mean %.2f ms, max %.2f ms, in capture queue mean %.2f ms, min %.2f ms", i,
+                 (unsigned long long)b.deliveries, b.deliveries ? b.total_out_ns / 1e6 / b.deliveries : 0.0, b.max_out_ns / 1e6,
+                 b.fills ? b.total_queued_ns / 1e6 / b.fills : 0.0, b.min_queued_ns / 1e6);
+    }
+}
+
+void FramePool::CheckStarvation()
+{
+    uint64_t events = starvation_events.load(std::memory_order_relaxed);
+    if (events != reported_starvation_events)
+    {
+        reported_starvation_events = events;
+        ROS_WARN_THROTTLE(1.0, "frame pool: camera ran out of queued buffers %llu times, consider raising num_frames (%zu)",
+                          (unsigned long long)events, slots.size());
+    }
+}
@@ -0,0 +1,115 @@
+/*=========================================================
+FrameWorker takes completed frames off the Vimba transport
+thread and processes them on a dedicated thread.
+===========================================================*/
+
+#include "avt_camera_streaming/FrameWorker.h"
+#include "ros/ros.h"
+#include "ros/console.h"
+#include "avt_camera_streaming/ThreadTuning.h"
+
+FrameWorker::FrameWorker(size_t queue_size, const FrameHandler &handler) : queue(queue_size), handler(handler), cpu(-1), running(false),
+    callback_calls(0), callback_total_ns(0), callback_max_ns(0)
+{
+    sem_init(&frames_available, 0, 0);
+}
+
+FrameWorker::~FrameWorker()
+{
+    Stop();
+    sem_destroy(&frames_available);
+}
+
+void FrameWorker::Start()
+{
+    if (running.exchange(true))
+    {
+        return;
+    }
+    thread = std::thread(&FrameWorker::Run, this);
+    if (!PinThread(thread, cpu))
+    {
+        ROS_ERROR("failed to pin the frame worker to cpu %d", cpu);
+    }
+}
+
+void FrameWorker::Stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    sem_post(&frames_available);    // wake the worker so it sees running == false
+    thread.join();
+
+    FrameLease lease;
+    while (queue.Pop(lease))
+    {
+        lease.Requeue();
+    }
+    LogStats();
+}
+
+bool FrameWorker::Submit(FrameLease &lease)
+{
+    if (!queue.Push(lease))
+    {
+        return false;
+    }
+    sem_post(&frames_available);
+    return true;
+}
+
+void FrameWorker::AddCallbackTime(uint64_t ns)
+{
+    callback_calls.fetch_add(1, std::memory_order_relaxed);
+    callback_total_ns.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t seen = callback_max_ns.load(std::memory_order_relaxed);
+    while (ns > seen && !callback_max_ns.compare_exchange_weak(seen, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+CallbackStats FrameWorker::GetCallbackStats() const
+{
+    CallbackStats stats;
+    stats.calls = callback_calls.load(std::memory_order_relaxed);
+    stats.total_ns = callback_total_ns.load(std::memory_order_relaxed);
+    stats.max_ns = callback_max_ns.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void FrameWorker::LogStats() const
+{
+    FrameQueueStats q = GetQueueStats();
+    CallbackStats cb = GetCallbackStats();
+    ROS_INFO("frame queue: %llu pushed, %llu popped, %llu overruns, occupancy %zu (max %zu of %zu)",
+             (unsigned long long)q.pushed, (unsigned long long)q.popped, (unsigned long long)q.overruns,
+             q.occupancy, q.max_occupancy, q.capacity);
+    ROS_INFO("frame callback: %llu calls, mean %.1f us, max %.1f us",
+             (unsigned long long)cb.calls, cb.calls ? cb.total_ns / 1000.0 / cb.calls : 0.0, cb.max_ns / 1000.0);
+}
+
+void FrameWorker::Run()
+{
+    uint64_t reported_overruns = 0;
+    while (running.load())
+    {
+        sem_wait(&frames_available);
+
+        FrameLease lease;
+        while (queue.Pop(lease))
+        {
+            handler(lease);
+            lease.Requeue();    // no-op if the handler did it already
+        }
+
+        // report from here rather than from the transport thread
+        uint64_t overruns = queue.GetStats().overruns;
+        if (overruns != reported_overruns)
+        {
+            ROS_WARN_THROTTLE(1.0, "frame queue overrun, %llu frames dropped so far", (unsigned long long)overruns);
+            reported_overruns = overruns;
+        }
+    }
+}
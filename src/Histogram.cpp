@@ -0,0 +1,64 @@
+/*=========================================================
+Lock-free latency histogram. Writers on any thread add
+samples with relaxed atomics; one reader takes the counts
+of the last window, e.g. once per second for diagnostics.
+===========================================================*/
+
+#include "avt_camera_streaming/Histogram.h"
+#include <algorithm>
+#include <cmath>
+
+const int HistogramSnapshot::BUCKETS;
+const int Histogram::BUCKETS;
+
+uint64_t HistogramSnapshot::PercentileNs(double q) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(q * count));
+    uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS - 1; ++b)
+    {
+        seen += buckets[b];
+        if (seen >= rank)
+        {
+            const uint64_t edge = Histogram::BucketStartUs(b + 1) * 1000;
+            return edge < max_ns ? edge : max_ns;
+        }
+    }
+    return max_ns;
+}
+
+Histogram::Histogram() : count(0), sum_ns(0), max_ns(0)
+{
+    for (int b = 0; b < BUCKETS; ++b)
+    {
+        buckets[b] = 0;
+    }
+}
+
+uint64_t Histogram::BucketStartUs(int b)
+{
+    if (b < 4)
+    {
+        return b;
+    }
+    return (uint64_t)(4 + b % 4) << (b / 4 - 1);
+}
+
+HistogramSnapshot Histogram::Take()
+{
+    // A sample added meanwhile may be split between two windows (bucket in one, sum in the
+    // next); that is fine for statistics that are read once a second.
+    HistogramSnapshot snapshot;
+    for (int b = 0; b < BUCKETS; ++b)
+    {
+        snapshot.buckets[b] = buckets[b].exchange(0, std::memory_order_relaxed);
+    }
+    snapshot.count = count.exchange(0, std::memory_order_relaxed);
+    snapshot.sum_ns = sum_ns.exchange(0, std::memory_order_relaxed);
+    snapshot.max_ns = max_ns.exchange(0, std::memory_order_relaxed);
+    return snapshot;
+}
@@ -0,0 +1,116 @@
+/*=========================================================
+Trigger to image latency, for comparing the nodelet against
+the standalone executable. Sends a software trigger, waits
+for the image and reports statistics over a window of frames.
+Run it in the camera's nodelet manager for the intra-process
+figure, or with `nodelet standalone` against avt_triggering
+for the serialized one. The camera needs trigger_source Software.
+===========================================================*/
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include "nodelet/nodelet.h"
+#include "pluginlib/class_list_macros.h"
+#include "ros/ros.h"
+#include "sensor_msgs/Image.h"
+#include "std_msgs/String.h"
+
+// a trigger without an image after this long is counted as lost and the next one is sent
+static const double MAX_WAIT_S = 1.0;
+
+class LatencyProbe : public nodelet::Nodelet
+{
+private:
+    virtual void onInit()
+    {
+        ros::NodeHandle &nh = getNodeHandle();
+        ros::NodeHandle &pnh = getPrivateNodeHandle();
+        double rate;
+        if(pnh.getParam("rate", rate) && rate > 0)
+        {
+            NODELET_INFO("Got rate %f", rate);
+        }
+        else
+        {
+            rate = 10.0;
+            NODELET_INFO("param 'rate' not set, using 10 Hz");
+        }
+        if(pnh.getParam("window", window) && window > 0)
+        {
+            NODELET_INFO("Got window %d", window);
+        }
+        else
+        {
+            window = 200;
+            NODELET_INFO("param 'window' not set, reporting every 200 frames");
+        }
+        waiting = false;
+        lost = 0;
+        trigger_pub = nh.advertise<std_msgs::String>("trigger", 1);
+        // a plain subscriber on the raw topic: in the same manager this is the publisher's message itself
+        image_sub = nh.subscribe("image", 1, &LatencyProbe::imageCb, this);
+        // timer and image callbacks share the nodelet's single-threaded queue, no locking needed
+        timer = nh.createTimer(ros::Duration(1.0 / rate), &LatencyProbe::timerCb, this);
+    }
+
+    void timerCb(const ros::TimerEvent &)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (waiting)
+        {
+            if (std::chrono::duration<double>(now - sent).count() < MAX_WAIT_S)
+            {
+                return;
+            }
+            lost++;
+        }
+        std_msgs::String trigger;
+        trigger.data = "latency_probe";
+        waiting = true;
+        sent = std::chrono::steady_clock::now();
+        trigger_pub.publish(trigger);
+    }
+
+    void imageCb(const sensor_msgs::ImageConstPtr &image)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (!waiting)
+        {
+            // not ours, e.g. a late image after a lost trigger
+            return;
+        }
+        waiting = false;
+        samples.push_back(std::chrono::duration<double, std::milli>(now - sent).count());
+        if ((int)samples.size() >= window)
+        {
+            Report(*image);
+            samples.clear();
+            lost = 0;
+        }
+    }
+
+    void Report(const sensor_msgs::Image &image)
+    {
+        std::sort(samples.begin(), samples.end());
+        double sum = 0;
+        for (size_t i = 0; i < samples.size(); ++i)
+        {
+            sum += samples[i];
+        }
+        NODELET_INFO("trigger to image, %ux%u %s, %zu frames: mean %.3f ms, median %.3f ms, p99 %.3f ms, max %.3f ms, %d lost",
+                     image.width, image.height, image.encoding.c_str(), samples.size(), sum / samples.size(),
+                     samples[samples.size() / 2], samples[samples.size() * 99 / 100], samples.back(), lost);
+    }
+
+    ros::Publisher trigger_pub;
+    ros::Subscriber image_sub;
+    ros::Timer timer;
+    int window;                  // frames per report
+    bool waiting;                // a trigger is out and its image has not arrived
+    int lost;                    // triggers without an image in this window
+    std::chrono::steady_clock::time_point sent;
+    std::vector<double> samples; // latencies in ms
+};
+
+PLUGINLIB_EXPORT_CLASS(LatencyProbe, nodelet::Nodelet)
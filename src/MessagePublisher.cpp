@@ -5,12 +5,137 @@
 
 #include "avt_camera_streaming/MessagePublisher.h"
 
+const size_t MessagePublisher::MAX_RECYCLED_MESSAGES;
+
 
 void MessagePublisher::PublishImage(cv::Mat &image, unsigned long long ts_cam)
 {
     msg = cv_bridge::CvImage(std_msgs::Header(), "bgr8", image).toImageMsg();
+    stats.messages_allocated++;
+    stats.bytes_copied += msg->data.size();
+    published++;
 
     msg->header.stamp = ros::Time().fromNSec(ts_cam); //old
     //msg->header.stamp = ros::Time::now(); //orig
     img_pub.publish(msg);
-}
\ No newline at end of file
+}
+
+sensor_msgs::ImagePtr MessagePublisher::AcquireImage(unsigned int height, unsigned int width, const std::string &encoding, unsigned int step)
+{
+    size_t size = (size_t)step * height;
+    sensor_msgs::ImagePtr image;
+    // The streams differ in size and come back in any order: prefer a free message that is large
+    // enough already, so a small one is only grown once, not every time a large one is busy.
+    for (size_t i = 0; i < recycled.size(); ++i)
+    {
+        if (recycled[i].unique())
+        {
+            if (recycled[i]->data.capacity() >= size)
+            {
+                image = recycled[i];
+                break;
+            }
+            if (!image)
+            {
+                image = recycled[i];
+            }
+        }
+    }
+    if (!image)
+    {
+        image = boost::make_shared<sensor_msgs::Image>();
+        stats.messages_allocated++;
+        if (recycled.size() < max_recycled)
+        {
+            recycled.push_back(image);
+        }
+    }
+
+    if (image->data.capacity() < size)
+    {
+        stats.buffer_reallocations++;
+    }
+    image->data.resize(size);
+    image->height = height;
+    image->width = width;
+    image->encoding = encoding;
+    image->is_bigendian = 0;
+    image->step = step;
+    return image;
+}
+
+void MessagePublisher::Preallocate(size_t count, size_t bytes)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    max_recycled = count;
+    if (recycled.size() > count)
+    {
+        recycled.resize(count);
+    }
+    while (recycled.size() < count)
+    {
+        recycled.push_back(boost::make_shared<sensor_msgs::Image>());
+    }
+    for (size_t i = 0; i < recycled.size(); ++i)
+    {
+        // resize, not reserve: writing the zeros makes the pages resident now instead of on the first frames
+        if (recycled[i]->data.size() < bytes)
+        {
+            recycled[i]->data.resize(bytes);
+        }
+    }
+}
+
+// topic suffixes, indexed by ImageStream
+static const char *STREAM_SUFFIX[NUM_IMAGE_STREAMS] = { "", "_color", "_preview", "_mono", "_rect" };
+
+void MessagePublisher::Advertise(ImageStream stream)
+{
+    if (stream != IMAGE_STREAM)
+    {
+        stream_pub[stream] = it.advertise(topic + STREAM_SUFFIX[stream], 1);
+    }
+}
+
+bool MessagePublisher::HasSubscribers(ImageStream stream) const
+{
+    return (stream == IMAGE_STREAM ? img_pub : stream_pub[stream]).getNumSubscribers() > 0;
+}
+
+void MessagePublisher::PublishImage(const sensor_msgs::ImagePtr &image, unsigned long long ts_cam, ImageStream stream)
+{
+    image->header.stamp = ros::Time().fromNSec(ts_cam);
+    // no copy for intra-process subscribers, and AcquireImage leaves the message alone until they let go
+    sensor_msgs::ImageConstPtr shared = image;
+    (stream == IMAGE_STREAM ? img_pub : stream_pub[stream]).publish(shared);
+    published++;
+}
+
+cv::Mat MessagePublisher::WrapImage(const sensor_msgs::ImagePtr &image, int type)
+{
+    return cv::Mat(image->height, image->width, type, image->data.data(), image->step);
+}
+
+PublishStats MessagePublisher::GetStats() const
+{
+    PublishStats result = stats;
+    result.published = published.load();
+    result.recycled_messages = recycled.size();
+    result.recycled_bytes = 0;
+    for (size_t i = 0; i < recycled.size(); ++i)
+    {
+        result.recycled_bytes += recycled[i]->data.capacity();
+    }
+    return result;
+}
+
+void MessagePublisher::LogStats() const
+{
+    PublishStats current = GetStats();
+    ROS_INFO("publisher: %llu images published, %llu message allocations, %llu buffer reallocations, %.1f MB copied",
+             current.published, current.messages_allocated, current.buffer_reallocations, current.bytes_copied / 1e6);
+    ROS_INFO("publisher: %zu recycled messages holding %.1f MB", current.recycled_messages, current.recycled_bytes / 1048576.0);
+}
@@ -0,0 +1,145 @@
+/*=========================================================
+Rectification from a camera_info calibration. The maps
+are computed once, in OpenCV's fixed-point form, and the
+remap runs in row bands on the shared ThreadPool.
+===========================================================*/
+
+#include "avt_camera_streaming/Rectifier.h"
+#include <algorithm>
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "ros/ros.h"
+#include "ros/console.h"
+
+Rectifier::Rectifier(ThreadPool &pool, int bands_per_thread) : pool(pool), bands_per_thread(std::max(1, bands_per_thread)), src_width(0), src_height(0)
+{
+}
+
+bool Rectifier::Configure(const sensor_msgs::CameraInfo &info, int downscale, const cv::Rect &roi)
+{
+    map_xy.release();
+    map_w.release();
+    bands.clear();
+    if (info.width == 0 || info.height == 0 || info.K[0] == 0)
+    {
+        ROS_ERROR("rectification: the camera_info has no calibration");
+        return false;
+    }
+    const cv::Rect frame(0, 0, info.width, info.height);
+    const cv::Rect area = roi.area() > 0 ? roi & frame : frame;
+    downscale = std::max(1, downscale);
+    if (area.width < downscale || area.height < downscale)
+    {
+        ROS_ERROR("rectification: roi %dx%d+%d+%d leaves no image", roi.width, roi.height, roi.x, roi.y);
+        return false;
+    }
+    if (!info.D.empty() && info.distortion_model != "plumb_bob" && info.distortion_model != "rational_polynomial")
+    {
+        ROS_ERROR("rectification: distortion model '%s' is not supported", info.distortion_model.c_str());
+        return false;
+    }
+
+    // copies, so the calibration can be patched up below
+    cv::Mat K = cv::Mat(3, 3, CV_64F, (void*)&info.K[0]).clone();
+    cv::Mat R = cv::Mat(3, 3, CV_64F, (void*)&info.R[0]).clone();
+    cv::Mat P = cv::Mat(3, 4, CV_64F, (void*)&info.P[0]).clone();
+    cv::Mat D;
+    if (!info.D.empty())
+    {
+        D = cv::Mat(1, (int)info.D.size(), CV_64F, (void*)&info.D[0]).clone();
+    }
+    // a monocular calibration leaves R and P empty: undistort only
+    if (cv::countNonZero(R) == 0)
+    {
+        R = cv::Mat::eye(3, 3, CV_64F);
+    }
+    if (P.at<double>(0, 0) == 0)
+    {
+        P = cv::Mat::zeros(3, 4, CV_64F);
+        K.copyTo(P.colRange(0, 3));
+    }
+    // output pixel u samples the middle of the downscale x downscale block at roi.x + u * downscale
+    const double shift_x = area.x + 0.5 * (downscale - 1), shift_y = area.y + 0.5 * (downscale - 1);
+    for (int c = 0; c < 4; ++c)
+    {
+        P.at<double>(0, c) = (P.at<double>(0, c) - shift_x * P.at<double>(2, c)) / downscale;
+        P.at<double>(1, c) = (P.at<double>(1, c) - shift_y * P.at<double>(2, c)) / downscale;
+    }
+    const int width = area.width / downscale;
+    const int height = area.height / downscale;
+    cv::initUndistortRectifyMap(K, D, R, P, cv::Size(width, height), CV_16SC2, map_xy, map_w);
+    projection = P;
+    src_width = info.width;
+    src_height = info.height;
+    int count = std::max(1, std::min(pool.ThreadCount() * bands_per_thread, height / 16));
+    const int band_rows = (height + count - 1) / count;
+    count = (height + band_rows - 1) / band_rows;
+    bands.resize(count);
+    for (int b = 0; b < count; ++b)
+    {
+        Band &band = bands[b];
+        band.y0 = b * band_rows;
+        band.y1 = std::min(height, band.y0 + band_rows);
+        // rows under the 2x2 taps of every output pixel that reads the image at all
+        int lo = src_height, hi = -1;
+        for (int y = band.y0; y < band.y1; ++y)
+        {
+            const short *xy = map_xy.ptr<short>(y);
+            for (int x = 0; x < width; ++x)
+            {
+                const int sx = xy[2 * x], sy = xy[2 * x + 1];
+                if (sx + 1 < 0 || sx >= src_width)
+                {
+                    continue;
+                }
+                lo = std::min(lo, std::max(sy, 0));
+                hi = std::max(hi, std::min(sy + 1, src_height - 1));
+            }
+        }
+        if (hi < lo)
+        {
+            // nothing in the band sees the image, it is all border
+            lo = 0;
+            hi = 0;
+        }
+        band.src_y0 = lo;
+        band.src_y1 = hi + 1;
+        // Taps outside [src_y0, src_y1) are outside the image too, so remapping from the scratch
+        // rows gives exactly what remapping from the whole frame would.
+        band.map_xy = map_xy.rowRange(band.y0, band.y1).clone();
+        for (int y = 0; y < band.map_xy.rows; ++y)
+        {
+            short *xy = band.map_xy.ptr<short>(y);
+            for (int x = 0; x < width; ++x)
+            {
+                xy[2 * x + 1] = (short)(xy[2 * x + 1] - band.src_y0);
+            }
+        }
+    }
+    ROS_INFO("rectification: %dx%d to %dx%d, %d bands", src_width, src_height, width, height, count);
+    return true;
+}
+
+void Rectifier::Remap(const cv::Mat &src, cv::Mat &dst) const
+{
+    pool.ParallelFor(bands.size(), [&](size_t b)
+    {
+        const Band &band = bands[b];
+        cv::Mat out = dst.rowRange(band.y0, band.y1);
+        cv::remap(src, out, map_xy.rowRange(band.y0, band.y1), map_w.rowRange(band.y0, band.y1), cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    });
+}
+
+void Rectifier::ConvertRemap(const cv::Mat &bayer, cv::Mat &dst, ConvertKernel kernel, const ColorLut *lut)
+{
+    pool.ParallelFor(bands.size(), [&](size_t b)
+    {
+        Band &band = bands[b];
+        band.scratch.create(band.src_y1 - band.src_y0, bayer.cols, dst.type());
+        // the kernels address output rows by their frame row, point row 0 of the frame at the scratch's origin
+        uint8_t *origin = band.scratch.data - (ptrdiff_t)band.src_y0 * band.scratch.step;
+        kernel(bayer.data, bayer.step, bayer.cols, bayer.rows, origin, band.scratch.step, band.src_y0, band.src_y1, lut);
+        cv::Mat out = dst.rowRange(band.y0, band.y1);
+        cv::remap(band.scratch, out, band.map_xy, map_w.rowRange(band.y0, band.y1), cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    });
+}
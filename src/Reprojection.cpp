@@ -0,0 +1,158 @@
+/*=========================================================
+Disparity to 3D points with the reprojection matrix Q of
+a rectified pair, with SSSE3 and AVX2 versions picked at
+runtime like the Bayer kernels.
+===========================================================*/
+
+#include "avt_camera_streaming/Reprojection.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define REPROJECTION_X86
+#endif
+
+void ReprojectionMatrix(const cv::Mat &left, const cv::Mat &right, float q[16])
+{
+    const double f = left.at<double>(0, 0);
+    const double cx = left.at<double>(0, 2);
+    const double cy = left.at<double>(1, 2);
+    const double right_cx = right.at<double>(0, 2);
+    // the right P holds Tx * f in P[3], Tx = -baseline
+    const double tx = right.at<double>(0, 0) != 0 ? right.at<double>(0, 3) / right.at<double>(0, 0) : 0;
+    const double Q[16] = { 1, 0, 0, -cx,
+                           0, 1, 0, -cy,
+                           0, 0, 0, f,
+                           0, 0, tx != 0 ? -1 / tx : 0, tx != 0 ? (cx - right_cx) / tx : 0 };
+    for (int i = 0; i < 16; ++i)
+    {
+        q[i] = (float)Q[i];
+    }
+}
+
+// columns [begin, end) of the row; the vector versions finish their rows with it
+static size_t ReprojectColumns(const float *disparity, size_t begin, size_t end, float u0, float du, float v,
+                               const float q[16], float min_disparity, float *xyz)
+{
+    // the v terms are the same for the whole row
+    const float x0 = q[1] * v + q[3], y0 = q[5] * v + q[7], z0 = q[9] * v + q[11], w0 = q[13] * v + q[15];
+    size_t points = 0;
+    for (size_t i = begin; i < end; ++i)
+    {
+        const float u = u0 + du * (float)i;
+        const float d = disparity[i];
+        const float w = q[12] * u + q[14] * d + w0;
+        if (!(d >= min_disparity) || !(w > 0))
+        {
+            continue;
+        }
+        const float inv = 1.0f / w;
+        xyz[3 * points] = (q[0] * u + q[2] * d + x0) * inv;
+        xyz[3 * points + 1] = (q[4] * u + q[6] * d + y0) * inv;
+        xyz[3 * points + 2] = (q[8] * u + q[10] * d + z0) * inv;
+        ++points;
+    }
+    return points;
+}
+
+size_t ReprojectReference(const float *disparity, size_t count, float u0, float du, float v,
+                          const float q[16], float min_disparity, float *xyz)
+{
+    return ReprojectColumns(disparity, 0, count, u0, du, v, q, min_disparity, xyz);
+}
+
+#ifdef REPROJECTION_X86
+namespace
+{
+// append the lanes set in mask, in order
+inline size_t Compact(const float *x, const float *y, const float *z, unsigned int mask, float *xyz)
+{
+    size_t points = 0;
+    while (mask)
+    {
+        const int lane = __builtin_ctz(mask);
+        xyz[3 * points] = x[lane];
+        xyz[3 * points + 1] = y[lane];
+        xyz[3 * points + 2] = z[lane];
+        ++points;
+        mask &= mask - 1;
+    }
+    return points;
+}
+
+__attribute__((target("ssse3")))
+size_t ReprojectSsse3(const float *disparity, size_t count, float u0, float du, float v,
+                      const float q[16], float min_disparity, float *xyz)
+{
+    const __m128 x0 = _mm_set1_ps(q[1] * v + q[3]), y0 = _mm_set1_ps(q[5] * v + q[7]);
+    const __m128 z0 = _mm_set1_ps(q[9] * v + q[11]), w0 = _mm_set1_ps(q[13] * v + q[15]);
+    const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+    const __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(), min_d = _mm_set1_ps(min_disparity);
+    alignas(16) float x[4], y[4], z[4];
+    size_t points = 0, i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 u = _mm_add_ps(_mm_set1_ps(u0), _mm_mul_ps(_mm_set1_ps(du), _mm_add_ps(_mm_set1_ps((float)i), lanes)));
+        const __m128 d = _mm_loadu_ps(disparity + i);
+        const __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(q[12]), u), _mm_mul_ps(_mm_set1_ps(q[14]), d)), w0);
+        // ordered compares, NaN is never a point
+        const unsigned int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(d, min_d), _mm_cmpgt_ps(w, zero)));
+        if (!mask)
+        {
+            continue;
+        }
+        const __m128 inv = _mm_div_ps(one, w);
+        _mm_store_ps(x, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(q[0]), u), _mm_mul_ps(_mm_set1_ps(q[2]), d)), x0), inv));
+        _mm_store_ps(y, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(q[4]), u), _mm_mul_ps(_mm_set1_ps(q[6]), d)), y0), inv));
+        _mm_store_ps(z, _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(q[8]), u), _mm_mul_ps(_mm_set1_ps(q[10]), d)), z0), inv));
+        points += Compact(x, y, z, mask, xyz + 3 * points);
+    }
+    return points + ReprojectColumns(disparity, i, count, u0, du, v, q, min_disparity, xyz + 3 * points);
+}
+
+__attribute__((target("avx2")))
+size_t ReprojectAvx2(const float *disparity, size_t count, float u0, float du, float v,
+                     const float q[16], float min_disparity, float *xyz)
+{
+    const __m256 x0 = _mm256_set1_ps(q[1] * v + q[3]), y0 = _mm256_set1_ps(q[5] * v + q[7]);
+    const __m256 z0 = _mm256_set1_ps(q[9] * v + q[11]), w0 = _mm256_set1_ps(q[13] * v + q[15]);
+    const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps(), min_d = _mm256_set1_ps(min_disparity);
+    alignas(32) float x[8], y[8], z[8];
+    size_t points = 0, i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        const __m256 u = _mm256_add_ps(_mm256_set1_ps(u0), _mm256_mul_ps(_mm256_set1_ps(du), _mm256_add_ps(_mm256_set1_ps((float)i), lanes)));
+        const __m256 d = _mm256_loadu_ps(disparity + i);
+        const __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(q[12]), u), _mm256_mul_ps(_mm256_set1_ps(q[14]), d)), w0);
+        const unsigned int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(d, min_d, _CMP_GE_OQ), _mm256_cmp_ps(w, zero, _CMP_GT_OQ)));
+        if (!mask)
+        {
+            continue;
+        }
+        const __m256 inv = _mm256_div_ps(one, w);
+        _mm256_store_ps(x, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(q[0]), u), _mm256_mul_ps(_mm256_set1_ps(q[2]), d)), x0), inv));
+        _mm256_store_ps(y, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(q[4]), u), _mm256_mul_ps(_mm256_set1_ps(q[6]), d)), y0), inv));
+        _mm256_store_ps(z, _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(q[8]), u), _mm256_mul_ps(_mm256_set1_ps(q[10]), d)), z0), inv));
+        points += Compact(x, y, z, mask, xyz + 3 * points);
+    }
+    return points + ReprojectColumns(disparity, i, count, u0, du, v, q, min_disparity, xyz + 3 * points);
+}
+}
+#endif
+
+ReprojectKernel SelectReprojectKernel(SimdLevel level)
+{
+#ifdef REPROJECTION_X86
+    if (level >= SIMD_AVX2)
+    {
+        return ReprojectAvx2;
+    }
+    if (level >= SIMD_SSSE3)
+    {
+        return ReprojectSsse3;
+    }
+#else
+    (void)level;
+#endif
+    return ReprojectReference;
+}
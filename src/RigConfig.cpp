@@ -0,0 +1,54 @@
+/*=========================================================
+A camera rig described in one YAML file, loaded into the
+node's private namespace with <rosparam command="load">.
+===========================================================*/
+
+#include "avt_camera_streaming/RigConfig.h"
+#include "ros/console.h"
+
+// every member of a struct value to <ns>/<member>, except the namespace itself
+static void CopyParams(ros::NodeHandle &private_nh, const std::string &ns, XmlRpc::XmlRpcValue &params)
+{
+    for (XmlRpc::XmlRpcValue::iterator it = params.begin(); it != params.end(); ++it)
+    {
+        if (it->first != "namespace")
+        {
+            private_nh.setParam(ns + "/" + it->first, it->second);
+        }
+    }
+}
+
+std::vector<std::string> LoadRigConfig(ros::NodeHandle &private_nh)
+{
+    std::vector<std::string> namespaces;
+    XmlRpc::XmlRpcValue cameras, defaults;
+    if (!private_nh.getParam("cameras", cameras))
+    {
+        return namespaces;
+    }
+    if (cameras.getType() != XmlRpc::XmlRpcValue::TypeArray)
+    {
+        ROS_ERROR("cameras must be a list of parameter sets, one per camera");
+        return namespaces;
+    }
+    const bool have_defaults = private_nh.getParam("defaults", defaults) && defaults.getType() == XmlRpc::XmlRpcValue::TypeStruct;
+    for (int i = 0; i < cameras.size(); ++i)
+    {
+        XmlRpc::XmlRpcValue &camera = cameras[i];
+        if (camera.getType() != XmlRpc::XmlRpcValue::TypeStruct || !camera.hasMember("namespace") ||
+            camera["namespace"].getType() != XmlRpc::XmlRpcValue::TypeString)
+        {
+            ROS_ERROR("cameras[%d] has no namespace, skipped", i);
+            continue;
+        }
+        const std::string ns = static_cast<std::string>(camera["namespace"]);
+        if (have_defaults)
+        {
+            CopyParams(private_nh, ns, defaults);
+        }
+        CopyParams(private_nh, ns, camera);
+        namespaces.push_back(ns);
+        ROS_INFO("rig camera %d: %s", (int)namespaces.size(), ns.c_str());
+    }
+    return namespaces;
+}
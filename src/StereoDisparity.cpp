@@ -0,0 +1,259 @@
+/*=========================================================
+Block matching on the rectified match images of a stereo
+pair, in overlapping row bands on the shared ThreadPool.
+Publishes stereo_msgs/DisparityImage, and optionally the
+points as sensor_msgs/PointCloud2.
+===========================================================*/
+
+#include "avt_camera_streaming/StereoDisparity.h"
+#include <algorithm>
+#include <chrono>
+#include "ros/console.h"
+
+StereoDisparity::StereoDisparity(ros::NodeHandle nh, const DisparityParams &params, const cv::Mat &left, const cv::Mat &right, int cloud_stride, ThreadPool &pool)
+    : params(params), pool(pool), width(0), height(0), cloud_stride(cloud_stride), running(false), waiting_ts(0), stats()
+{
+    pub = nh.advertise<stereo_msgs::DisparityImage>("disparity", 1);
+    ReprojectionMatrix(left, right, q);
+    reproject = SelectReprojectKernel(DetectSimdLevel());
+    if (cloud_stride > 0)
+    {
+        cloud_pub = nh.advertise<sensor_msgs::PointCloud2>("points2", 1);
+    }
+    focal = left.at<double>(0, 0);
+    // the right camera's P holds -f * baseline in P[3]
+    baseline = right.at<double>(0, 0) != 0 ? -right.at<double>(0, 3) / right.at<double>(0, 0) : 0;
+    if (baseline == 0)
+    {
+        ROS_ERROR("disparity: the right camera's P has no baseline, is the calibration a stereo calibration?");
+    }
+}
+
+StereoDisparity::~StereoDisparity()
+{
+    Stop();
+}
+
+void StereoDisparity::Start()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running)
+    {
+        return;
+    }
+    running = true;
+    thread = std::thread(&StereoDisparity::Run, this);
+}
+
+void StereoDisparity::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running)
+        {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+    LogStats();
+}
+
+void StereoDisparity::Submit(const sensor_msgs::ImagePtr &left, const sensor_msgs::ImagePtr &right, unsigned long long ts_cam)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (waiting[0])
+        {
+            stats.dropped++;
+        }
+        waiting[0] = left;
+        waiting[1] = right;
+        waiting_ts = ts_cam;
+    }
+    wake.notify_one();
+}
+
+void StereoDisparity::Run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [this] { return !running || waiting[0]; });
+        if (!running)
+        {
+            break;
+        }
+        sensor_msgs::ImagePtr left, right;
+        left.swap(waiting[0]);
+        right.swap(waiting[1]);
+        const unsigned long long ts_cam = waiting_ts;
+        lock.unlock();
+
+        // the match images are released (and recycled by their camera) when left and right go out of scope
+        if (left->width != right->width || left->height != right->height)
+        {
+            ROS_ERROR_THROTTLE(5.0, "disparity: the match images differ in size, %ux%u and %ux%u", left->width, left->height, right->width, right->height);
+        }
+        else
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            Match(cv::Mat(left->height, left->width, CV_8UC1, left->data.data(), left->step),
+                  cv::Mat(right->height, right->width, CV_8UC1, right->data.data(), right->step), ts_cam, left->header.frame_id);
+            match_time.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            if (cloud_stride > 0 && cloud_pub.getNumSubscribers() > 0)
+            {
+                start = std::chrono::steady_clock::now();
+                const sensor_msgs::Image &image = msg->image;
+                PublishCloud(cv::Mat(image.height, image.width, CV_32F, (void*)image.data.data(), image.step), left->header.frame_id);
+                cloud_time.Add(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+            }
+        }
+        lock.lock();
+        stats.matched++;
+    }
+}
+
+void StereoDisparity::Prepare(int w, int h)
+{
+    width = w;
+    height = h;
+    disparity.create(height, width, CV_16S);
+    // The x-Sobel prefilter reads one row above and below, the block block_size / 2. StereoBM leaves
+    // that many rows at the edges of its input invalid, they are in the overlap and thrown away.
+    const int reach = params.block_size / 2 + 2;
+    int count = std::max(1, std::min(pool.ThreadCount() * 2, height / (4 * params.block_size)));
+    const int band_rows = (height + count - 1) / count;
+    count = (height + band_rows - 1) / band_rows;
+    bands.resize(count);
+    for (int b = 0; b < count; ++b)
+    {
+        Band &band = bands[b];
+        band.y0 = b * band_rows;
+        band.y1 = std::min(height, band.y0 + band_rows);
+        band.src_y0 = std::max(0, band.y0 - reach);
+        band.src_y1 = std::min(height, band.y1 + reach);
+        band.matcher = cv::StereoBM::create(params.num_disparities, params.block_size);
+        band.matcher->setPreFilterType(cv::StereoBM::PREFILTER_XSOBEL);
+        band.matcher->setMinDisparity(params.min_disparity);
+        band.matcher->setTextureThreshold(params.texture_threshold);
+        band.matcher->setUniquenessRatio(params.uniqueness_ratio);
+        // speckles are connected regions, they are filtered on the whole image below
+        band.matcher->setSpeckleWindowSize(0);
+    }
+    ROS_INFO("disparity: %dx%d, %d disparities, block %d, %d bands", width, height, params.num_disparities, params.block_size, count);
+}
+
+void StereoDisparity::Match(const cv::Mat &left, const cv::Mat &right, unsigned long long ts_cam, const std::string &frame_id)
+{
+    if (left.cols != width || left.rows != height)
+    {
+        Prepare(left.cols, left.rows);
+    }
+    pool.ParallelFor(bands.size(), [&](size_t b)
+    {
+        Band &band = bands[b];
+        band.matcher->compute(left.rowRange(band.src_y0, band.src_y1), right.rowRange(band.src_y0, band.src_y1), band.disparity);
+        band.disparity.rowRange(band.y0 - band.src_y0, band.y1 - band.src_y0).copyTo(disparity.rowRange(band.y0, band.y1));
+    });
+    // StereoBM marks invalid pixels with (min_disparity - 1) * 16
+    const int invalid = (params.min_disparity - 1) * 16;
+    if (params.speckle_window_size > 0)
+    {
+        cv::filterSpeckles(disparity, invalid, params.speckle_window_size, params.speckle_range * 16, speckle_buffer);
+    }
+
+    if (!msg || !msg.unique())
+    {
+        msg = boost::make_shared<stereo_msgs::DisparityImage>();
+    }
+    msg->header.stamp = ros::Time().fromNSec(ts_cam);
+    msg->header.frame_id = frame_id;
+    sensor_msgs::Image &image = msg->image;
+    image.header = msg->header;
+    image.height = height;
+    image.width = width;
+    image.encoding = "32FC1";
+    image.is_bigendian = 0;
+    image.step = width * sizeof(float);
+    image.data.resize((size_t)image.step * height);
+    cv::Mat out(height, width, CV_32F, image.data.data(), image.step);
+    disparity.convertTo(out, CV_32F, 1.0 / 16);
+
+    msg->f = focal;
+    msg->T = baseline;
+    const cv::Rect valid = cv::getValidDisparityROI(cv::Rect(0, 0, width, height), cv::Rect(0, 0, width, height),
+                                                    params.min_disparity, params.num_disparities, params.block_size);
+    msg->valid_window.x_offset = valid.x;
+    msg->valid_window.y_offset = valid.y;
+    msg->valid_window.width = valid.width;
+    msg->valid_window.height = valid.height;
+    msg->min_disparity = params.min_disparity;
+    msg->max_disparity = params.min_disparity + params.num_disparities - 1;
+    msg->delta_d = 1.0 / 16;
+    pub.publish(msg);
+}
+
+void StereoDisparity::PublishCloud(const cv::Mat &image, const std::string &frame_id)
+{
+    const size_t columns = (image.cols + cloud_stride - 1) / cloud_stride;
+    const size_t rows = (image.rows + cloud_stride - 1) / cloud_stride;
+    if (!cloud || !cloud.unique())
+    {
+        cloud = boost::make_shared<sensor_msgs::PointCloud2>();
+        const char *names[] = { "x", "y", "z" };
+        cloud->fields.resize(3);
+        for (int i = 0; i < 3; ++i)
+        {
+            cloud->fields[i].name = names[i];
+            cloud->fields[i].offset = i * sizeof(float);
+            cloud->fields[i].datatype = sensor_msgs::PointField::FLOAT32;
+            cloud->fields[i].count = 1;
+        }
+        cloud->point_step = 3 * sizeof(float);
+        cloud->is_bigendian = false;
+        cloud->is_dense = true;
+    }
+    // room for every sampled pixel; after the first frame of this size this neither allocates nor,
+    // as long as the previous cloud was about as large, fills much
+    cloud->data.resize(columns * rows * cloud->point_step);
+    gathered.resize(columns);
+    float *xyz = reinterpret_cast<float*>(cloud->data.data());
+    size_t points = 0;
+    for (int v = 0; v < image.rows; v += cloud_stride)
+    {
+        const float *row = image.ptr<float>(v);
+        if (cloud_stride > 1)
+        {
+            for (size_t i = 0; i < columns; ++i)
+            {
+                gathered[i] = row[i * cloud_stride];
+            }
+            row = gathered.data();
+        }
+        points += reproject(row, columns, 0.0f, (float)cloud_stride, (float)v, q, (float)params.min_disparity, xyz + 3 * points);
+    }
+    // only valid points are written, packed: an unorganized, dense cloud
+    // Q maps into the rectified left camera, so that is the cloud's frame; rviz and tf drop clouds without one
+    cloud->header.stamp = msg->header.stamp;
+    cloud->header.frame_id = frame_id;
+    cloud->height = 1;
+    cloud->width = points;
+    cloud->row_step = points * cloud->point_step;
+    cloud->data.resize(cloud->row_step);
+    cloud_pub.publish(cloud);
+}
+
+DisparityStats StereoDisparity::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void StereoDisparity::LogStats() const
+{
+    DisparityStats current = GetStats();
+    ROS_INFO("disparity: %llu pairs matched, %llu dropped while the matcher was busy",
+             (unsigned long long)current.matched, (unsigned long long)current.dropped);
+}
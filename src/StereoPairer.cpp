@@ -0,0 +1,99 @@
+/*=========================================================
+Matches the frames of the two stereo cameras by their
+hardware (PTP) timestamp and publishes complete pairs only,
+both images with the same header stamp.
+===========================================================*/
+
+#include "avt_camera_streaming/StereoPairer.h"
+#include "ros/ros.h"
+#include "ros/console.h"
+
+const size_t StereoPairer::MAX_PENDING;
+const uint64_t StereoPairer::ORPHANS_BEFORE_ERROR;
+
+StereoPairer::StereoPairer(uint64_t tolerance_ns, const Publisher &left, const Publisher &right) : tolerance_ns(tolerance_ns), stats(), orphans_since_pair(0)
+{
+    publishers[LEFT] = left;
+    publishers[RIGHT] = right;
+    pending[LEFT].reserve(MAX_PENDING + 1);
+    pending[RIGHT].reserve(MAX_PENDING + 1);
+}
+
+void StereoPairer::Add(Side side, const sensor_msgs::ImagePtr &image, const sensor_msgs::ImagePtr &match, unsigned long long ts_cam)
+{
+    Pending left, right;
+    uint64_t unmatched = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Pending frame = { image, match, ts_cam };
+        pending[side].push_back(frame);
+        if (pending[side].size() > MAX_PENDING)
+        {
+            // the other camera stopped delivering
+            pending[side].erase(pending[side].begin());
+            stats.orphans[side]++;
+            orphans_since_pair++;
+        }
+        // Both queues are in timestamp order. If the two oldest frames are too far apart, the older
+        // one can never be matched: everything still to come from the other side is even later.
+        while (!pending[LEFT].empty() && !pending[RIGHT].empty())
+        {
+            const unsigned long long l = pending[LEFT].front().ts_cam;
+            const unsigned long long r = pending[RIGHT].front().ts_cam;
+            const uint64_t skew_ns = l > r ? l - r : r - l;
+            if (skew_ns <= tolerance_ns)
+            {
+                left = pending[LEFT].front();
+                right = pending[RIGHT].front();
+                pending[LEFT].erase(pending[LEFT].begin());
+                pending[RIGHT].erase(pending[RIGHT].begin());
+                stats.pairs++;
+                orphans_since_pair = 0;
+                stats.total_skew_ns += skew_ns;
+                skew.Add(skew_ns);
+                if (skew_ns > stats.max_skew_ns)
+                {
+                    stats.max_skew_ns = skew_ns;
+                }
+                // one frame completes at most one pair
+                break;
+            }
+            const Side older = l < r ? LEFT : RIGHT;
+            pending[older].erase(pending[older].begin());
+            stats.orphans[older]++;
+            orphans_since_pair++;
+        }
+        unmatched = orphans_since_pair;
+    }
+    if (unmatched >= ORPHANS_BEFORE_ERROR)
+    {
+        // e.g. two free-running camera clocks: nothing will ever be published
+        ROS_ERROR_THROTTLE(5.0, "stereo pairing: %llu frames in a row without a partner, no pairs published. "
+                           "Are both cameras on PTP (ptp_mode) and pair_tolerance_ms large enough? Else set pair_frames false",
+                           (unsigned long long)unmatched);
+    }
+    if (left.image)
+    {
+        // the pair carries the left camera's stamp
+        publishers[LEFT](left.image, left.ts_cam);
+        publishers[RIGHT](right.image, left.ts_cam);
+        if (pair_handler && left.match && right.match)
+        {
+            pair_handler(left.match, right.match, left.ts_cam);
+        }
+    }
+}
+
+StereoPairStats StereoPairer::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void StereoPairer::LogStats() const
+{
+    StereoPairStats current = GetStats();
+    ROS_INFO("stereo pairing: %llu pairs, skew mean %.1f us, max %.1f us, %llu left and %llu right frames without a partner",
+             (unsigned long long)current.pairs, current.pairs ? current.total_skew_ns / 1000.0 / current.pairs : 0.0,
+             current.max_skew_ns / 1000.0, (unsigned long long)current.orphans[LEFT], (unsigned long long)current.orphans[RIGHT]);
+}
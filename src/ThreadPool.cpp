@@ -0,0 +1,179 @@
+/*=========================================================
+Persistent worker threads shared by every camera pipeline
+in the process. Used to split per-frame work into bands.
+===========================================================*/
+
+#include "avt_camera_streaming/ThreadPool.h"
+#include <algorithm>
+
+// jobs running at the same time, about one per camera pipeline; more only costs an allocation
+static const size_t RESERVED_JOBS = 64;
+
+ThreadPool &ThreadPool::Shared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool(int threads) : stopping(false), configured(false), callers(0)
+{
+    jobs.reserve(RESERVED_JOBS);
+    Start(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    Stop();
+}
+
+bool ThreadPool::Configure(int threads)
+{
+    threads = Resolve(threads);
+    std::lock_guard<std::mutex> lock(configure_mutex);
+    if (threads == ThreadCount())
+    {
+        configured = true;
+        return true;
+    }
+    // e.g. a second camera nodelet loaded into a manager whose first camera is streaming:
+    // restarting would pull the workers out from under its ParallelFor
+    if (configured || callers.load() > 0)
+    {
+        return false;
+    }
+    configured = true;
+    Stop();
+    Start(threads);
+    return true;
+}
+
+int ThreadPool::Resolve(int threads)
+{
+    return threads > 0 ? threads : (int)std::max(1u, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::Start(int threads)
+{
+    threads = Resolve(threads);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+    }
+    for (int i = 1; i < threads; ++i)
+    {
+        workers.push_back(std::thread(&ThreadPool::Run, this));
+    }
+}
+
+void ThreadPool::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); ++i)
+    {
+        workers[i].join();
+    }
+    workers.clear();
+}
+
+void ThreadPool::Work(Job &job)
+{
+    size_t i;
+    while ((i = job.next.fetch_add(1)) < job.count)
+    {
+        job.call(job.task, i);
+        if (job.done.fetch_add(1) + 1 == job.count)
+        {
+            std::lock_guard<std::mutex> lock(job.mutex);
+            job.finished.notify_all();
+        }
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, TaskCall call, const void *task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    // seen by Configure(), which does not resize the pool under a running call
+    struct Caller
+    {
+        explicit Caller(std::atomic<int> &callers) : callers(callers) { callers.fetch_add(1); }
+        ~Caller() { callers.fetch_sub(1); }
+        std::atomic<int> &callers;
+    } caller(callers);
+    if (count == 1 || workers.empty())
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            call(task, i);
+        }
+        return;
+    }
+
+    // one job per calling thread, reused once no worker holds it any more
+    thread_local std::shared_ptr<Job> spare;
+    if (!spare || !spare.unique())
+    {
+        spare = std::make_shared<Job>();
+    }
+    std::shared_ptr<Job> job = spare;
+    job->call = call;
+    job->task = task;
+    job->count = count;
+    job->next = 0;
+    job->done = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(job);
+    }
+    wake.notify_all();
+
+    Work(*job);
+
+    {
+        std::unique_lock<std::mutex> lock(job->mutex);
+        job->finished.wait(lock, [&job] { return job->done.load() == job->count; });
+    }
+    // workers hold their own reference, so job may outlive this call; task is never run after this point.
+    // If no worker got to it, it is still listed: take it out so the next call can reuse it.
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::shared_ptr<Job> >::iterator listed = std::find(jobs.begin(), jobs.end(), job);
+    if (listed != jobs.end())
+    {
+        jobs.erase(listed);
+    }
+}
+
+void ThreadPool::Run()
+{
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (stopping)
+            {
+                return;
+            }
+            job = jobs.front();
+            if (job->next.load() >= job->count)
+            {
+                // every index is claimed, nothing left for the pool to do on this one
+                jobs.erase(jobs.begin());
+                continue;
+            }
+        }
+        Work(*job);
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!jobs.empty() && jobs.front() == job)
+        {
+            jobs.erase(jobs.begin());
+        }
+    }
+}
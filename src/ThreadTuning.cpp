@@ -0,0 +1,32 @@
+/*=========================================================
+Pinning and real-time scheduling for the driver's own
+threads: the frame worker, the trigger listener and the
+trigger generator.
+===========================================================*/
+
+#include "avt_camera_streaming/ThreadTuning.h"
+#include <pthread.h>
+#include <sched.h>
+
+bool PinThread(std::thread &thread, int cpu)
+{
+    if (cpu < 0)
+    {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+}
+
+bool SetFifoPriority(std::thread &thread, int priority)
+{
+    if (priority <= 0)
+    {
+        return true;
+    }
+    sched_param param;
+    param.sched_priority = priority;
+    return pthread_setschedparam(thread.native_handle(), SCHED_FIFO, &param) == 0;
+}
@@ -0,0 +1,82 @@
+/*=========================================================
+Frame timing histograms, published once a second on
+/diagnostics: frame interval and jitter, host receive
+delay, stereo skew.
+===========================================================*/
+
+#include "avt_camera_streaming/TimingDiagnostics.h"
+#include <cstdio>
+#include "diagnostic_msgs/DiagnosticArray.h"
+
+void FrameTiming::OnFrame(uint64_t ts_cam, uint64_t host_ns)
+{
+    if (host_ns >= ts_cam)
+    {
+        receive_delay.Add(host_ns - ts_cam);
+    }
+    if (last_ts && ts_cam > last_ts)
+    {
+        const uint64_t frame_interval = ts_cam - last_ts;
+        interval.Add(frame_interval);
+        if (last_interval)
+        {
+            jitter.Add(frame_interval > last_interval ? frame_interval - last_interval : last_interval - frame_interval);
+        }
+        last_interval = frame_interval;
+    }
+    last_ts = ts_cam;
+}
+
+TimingDiagnostics::TimingDiagnostics(ros::NodeHandle nh, const std::string &name) : name(name)
+{
+    pub = nh.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 1);
+    timer = nh.createTimer(ros::Duration(1.0), &TimingDiagnostics::timerCb, this);
+}
+
+void TimingDiagnostics::Add(const std::string &label, Histogram &histogram)
+{
+    histograms.push_back(std::make_pair(label, &histogram));
+}
+
+void TimingDiagnostics::Add(FrameTiming &timing)
+{
+    Add("interval", timing.interval);
+    Add("jitter", timing.jitter);
+    Add("receive delay", timing.receive_delay);
+}
+
+static diagnostic_msgs::KeyValue KeyValue(const std::string &key, double value)
+{
+    diagnostic_msgs::KeyValue kv;
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.1f", value);
+    kv.key = key;
+    kv.value = text;
+    return kv;
+}
+
+void TimingDiagnostics::timerCb(const ros::TimerEvent &)
+{
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = name + ": frame timing";
+    status.hardware_id = name;
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    uint64_t samples = 0;
+    for (size_t i = 0; i < histograms.size(); ++i)
+    {
+        const std::string &label = histograms[i].first;
+        HistogramSnapshot window = histograms[i].second->Take();
+        samples += window.count;
+        status.values.push_back(KeyValue(label + " count", window.count));
+        status.values.push_back(KeyValue(label + " mean [us]", window.MeanNs() / 1000.0));
+        status.values.push_back(KeyValue(label + " p50 [us]", window.PercentileNs(0.5) / 1000.0));
+        status.values.push_back(KeyValue(label + " p99 [us]", window.PercentileNs(0.99) / 1000.0));
+        status.values.push_back(KeyValue(label + " max [us]", window.max_ns / 1000.0));
+    }
+    status.message = samples ? "last second" : "no frames in the last second";
+
+    diagnostic_msgs::DiagnosticArray array;
+    array.header.stamp = ros::Time::now();
+    array.status.push_back(status);
+    pub.publish(array);
+}
@@ -0,0 +1,209 @@
+/*=========================================================
+Triggers from inside the driver instead of from a trigger
+topic: a thread sleeps on clock_nanosleep to absolute ticks
+of the system clock, at a fixed rate and phase, and fires
+the handler (TriggerSoftware on the cameras) on each tick.
+Records how late each tick fired and how far the intervals
+strayed from the period.
+===========================================================*/
+
+#include "avt_camera_streaming/TriggerGenerator.h"
+#include <cerrno>
+#include <time.h>
+#include "ros/console.h"
+#include "avt_camera_streaming/ThreadTuning.h"
+
+// the longest single sleep, so Stop() never waits for a slow tick
+static const uint64_t MAX_SLEEP_NS = 100000000;
+
+// CLOCK_REALTIME, so the ticks of several hosts line up when their clocks are synchronised (PTP)
+static uint64_t RealtimeNs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+TriggerGenerator::TriggerGenerator(ros::NodeHandle private_nh, const Handler &handler)
+    : handler(handler), period_ns(0), phase_ns(0), running(false), fired(0), skipped(0), held_back(0), max_late_ns(0), first_fire_ns(0), last_fire_ns(0)
+{
+    double rate;
+    if(private_nh.getParam("trigger_rate", rate) && rate > 0)
+    {
+        period_ns = (uint64_t)(1e9 / rate);
+        ROS_INFO("Got trigger_rate %f", rate);
+    }
+    else
+    {
+        ROS_INFO("param 'trigger_rate' not set, no internal trigger");
+    }
+    double phase_ms;
+    if(private_nh.getParam("trigger_phase_ms", phase_ms))
+    {
+        ROS_INFO("Got trigger_phase_ms %f", phase_ms);
+    }
+    else
+    {
+        phase_ms = 0;
+        ROS_INFO("param 'trigger_phase_ms' not set, ticks on multiples of the period");
+    }
+    if (period_ns > 0)
+    {
+        // any phase, also negative or beyond a period, is an offset within one period
+        const int64_t phase = (int64_t)(phase_ms * 1e6) % (int64_t)period_ns;
+        phase_ns = phase < 0 ? phase + period_ns : phase;
+    }
+    if(private_nh.getParam("trigger_generator_priority", priority))
+    {
+        ROS_INFO("Got trigger_generator_priority %i", priority);
+    }
+    else
+    {
+        priority = 0;
+        ROS_INFO("param 'trigger_generator_priority' not set, normal scheduling");
+    }
+    if(private_nh.getParam("trigger_generator_cpu", cpu))
+    {
+        ROS_INFO("Got trigger_generator_cpu %i", cpu);
+    }
+    else
+    {
+        cpu = -1;
+        ROS_INFO("param 'trigger_generator_cpu' not set, generator thread not pinned");
+    }
+}
+
+TriggerGenerator::~TriggerGenerator()
+{
+    Stop();
+}
+
+void TriggerGenerator::Start()
+{
+    if (!Enabled() || running.exchange(true))
+    {
+        return;
+    }
+    fired = 0;
+    skipped = 0;
+    held_back = 0;
+    max_late_ns = 0;
+    first_fire_ns = 0;
+    last_fire_ns = 0;
+    thread = std::thread(&TriggerGenerator::Run, this);
+    if (!PinThread(thread, cpu))
+    {
+        ROS_ERROR("failed to pin the trigger generator to cpu %d", cpu);
+    }
+    if (!SetFifoPriority(thread, priority))
+    {
+        ROS_WARN("cannot give the trigger generator SCHED_FIFO priority %d, needs CAP_SYS_NICE or an rtprio limit", priority);
+    }
+    ROS_INFO("trigger generator: %.3f Hz, phase %.3f ms", Rate(), phase_ns / 1e6);
+}
+
+void TriggerGenerator::Stop()
+{
+    if (!running.exchange(false))
+    {
+        return;
+    }
+    thread.join();
+}
+
+void TriggerGenerator::SleepUntil(uint64_t due_ns)
+{
+    while (running)
+    {
+        const uint64_t now_ns = RealtimeNs();
+        if (now_ns >= due_ns)
+        {
+            return;
+        }
+        // absolute: how long the previous tick took does not shift this one
+        const uint64_t wake_ns = due_ns - now_ns > MAX_SLEEP_NS ? now_ns + MAX_SLEEP_NS : due_ns;
+        timespec ts;
+        ts.tv_sec = wake_ns / 1000000000ull;
+        ts.tv_nsec = wake_ns % 1000000000ull;
+        int err;
+        do
+        {
+            err = clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME, &ts, NULL);
+        }
+        while (err == EINTR);
+    }
+}
+
+void TriggerGenerator::Run()
+{
+    // the first tick after now
+    uint64_t due_ns = RealtimeNs();
+    due_ns = (due_ns - phase_ns) / period_ns * period_ns + period_ns + phase_ns;
+    uint64_t previous_ns = 0;
+    while (running)
+    {
+        SleepUntil(due_ns);
+        if (!running)
+        {
+            break;
+        }
+        const uint64_t now_ns = RealtimeNs();
+        if (!handler())
+        {
+            held_back.fetch_add(1, std::memory_order_relaxed);
+        }
+        // the system clock may be stepped; a step back must not look like an hour late
+        const uint64_t late_ns = now_ns > due_ns ? now_ns - due_ns : 0;
+        late.Add(late_ns);
+        if (late_ns > max_late_ns.load(std::memory_order_relaxed))
+        {
+            max_late_ns.store(late_ns, std::memory_order_relaxed);
+        }
+        if (previous_ns && now_ns > previous_ns)
+        {
+            const uint64_t interval_ns = now_ns - previous_ns;
+            deviation.Add(interval_ns > period_ns ? interval_ns - period_ns : period_ns - interval_ns);
+        }
+        else if (!previous_ns)
+        {
+            first_fire_ns.store(now_ns, std::memory_order_relaxed);
+        }
+        previous_ns = now_ns;
+        last_fire_ns.store(now_ns, std::memory_order_relaxed);
+        fired.fetch_add(1, std::memory_order_relaxed);
+        due_ns += period_ns;
+        // woke up (or fired) too late for the next tick: keep the grid, skip what has passed
+        const uint64_t after_ns = RealtimeNs();
+        if (after_ns >= due_ns)
+        {
+            const uint64_t missed = (after_ns - due_ns) / period_ns + 1;
+            skipped.fetch_add(missed, std::memory_order_relaxed);
+            due_ns += missed * period_ns;
+        }
+    }
+}
+
+TriggerGeneratorStats TriggerGenerator::GetStats() const
+{
+    TriggerGeneratorStats stats;
+    stats.fired = fired.load(std::memory_order_relaxed);
+    stats.skipped = skipped.load(std::memory_order_relaxed);
+    stats.held_back = held_back.load(std::memory_order_relaxed);
+    stats.max_late_ns = max_late_ns.load(std::memory_order_relaxed);
+    const uint64_t first = first_fire_ns.load(std::memory_order_relaxed);
+    const uint64_t last = last_fire_ns.load(std::memory_order_relaxed);
+    stats.achieved_rate = stats.fired > 1 && last > first ? (stats.fired - 1) * 1e9 / (last - first) : 0.0;
+    return stats;
+}
+
+void TriggerGenerator::LogStats() const
+{
+    if (!Enabled())
+    {
+        return;
+    }
+    TriggerGeneratorStats stats = GetStats();
+    ROS_INFO("trigger generator: %llu fired at %.3f Hz (asked %.3f Hz), %llu held back as too fast for the cameras, %llu ticks skipped, at most %.3f ms late",
+             (unsigned long long)stats.fired, stats.achieved_rate, Rate(), (unsigned long long)stats.held_back, (unsigned long long)stats.skipped,
+             stats.max_late_ns / 1e6);
+}
@@ -0,0 +1,136 @@
+/*=========================================================
+Keeps triggers at or below the rate the camera can take
+frames, given by its exposure and frame rate limits. A
+trigger that comes too early is rejected, or coalesced
+with the other early ones into one trigger sent as soon as
+the camera is ready again; either way it is counted.
+===========================================================*/
+
+#include "avt_camera_streaming/TriggerGovernor.h"
+#include "ros/ros.h"
+#include "ros/console.h"
+
+bool ParseGovernorMode(const std::string &name, GovernorMode &mode)
+{
+    if (name == "off")
+    {
+        mode = GOVERNOR_OFF;
+    }
+    else if (name == "reject")
+    {
+        mode = GOVERNOR_REJECT;
+    }
+    else if (name == "coalesce")
+    {
+        mode = GOVERNOR_COALESCE;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+const char *GovernorModeName(GovernorMode mode)
+{
+    switch (mode)
+    {
+    case GOVERNOR_OFF: return "off";
+    case GOVERNOR_REJECT: return "reject";
+    case GOVERNOR_COALESCE: return "coalesce";
+    }
+    return "?";
+}
+
+TriggerGovernor::TriggerGovernor() : mode(GOVERNOR_REJECT), min_period_ns(0), have_sent(false), last_sent_ns(0), deferred(false), stats()
+{
+}
+
+void TriggerGovernor::SetMode(GovernorMode new_mode)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    mode = new_mode;
+    deferred = deferred && mode == GOVERNOR_COALESCE;
+}
+
+void TriggerGovernor::SetMinPeriod(double period_s)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    min_period_ns = period_s > 0 ? (uint64_t)(period_s * 1e9) : 0;
+}
+
+double TriggerGovernor::MinPeriod() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return min_period_ns / 1e9;
+}
+
+TriggerGovernor::Decision TriggerGovernor::OnTrigger(uint64_t now_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats.received++;
+    if (!have_sent || min_period_ns == 0 || now_ns >= last_sent_ns + min_period_ns)
+    {
+        if (deferred)
+        {
+            // the deferred one is due anyway, this trigger is it
+            stats.coalesced++;
+        }
+        return SEND;
+    }
+    stats.early++;
+    switch (mode)
+    {
+    case GOVERNOR_REJECT:
+        stats.rejected++;
+        return REJECT;
+    case GOVERNOR_COALESCE:
+        if (deferred)
+        {
+            stats.coalesced++;
+        }
+        deferred = true;
+        return DEFER;
+    default:
+        return SEND;
+    }
+}
+
+void TriggerGovernor::Sent(uint64_t now_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    have_sent = true;
+    last_sent_ns = now_ns;
+    deferred = false;
+    stats.sent++;
+}
+
+bool TriggerGovernor::Deferred() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return deferred;
+}
+
+uint64_t TriggerGovernor::DueNs() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return last_sent_ns + min_period_ns;
+}
+
+TriggerGovernorStats TriggerGovernor::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void TriggerGovernor::LogStats() const
+{
+    TriggerGovernorStats current = GetStats();
+    if (current.received == 0)
+    {
+        return;
+    }
+    ROS_INFO("trigger governor (%s, min period %.3f ms): %llu asked for, %llu sent, %llu early, %llu rejected, %llu coalesced",
+             GovernorModeName(mode), MinPeriod() * 1e3, (unsigned long long)current.received, (unsigned long long)current.sent,
+             (unsigned long long)current.early, (unsigned long long)current.rejected, (unsigned long long)current.coalesced);
+}
@@ -0,0 +1,165 @@
+/*=========================================================
+The trigger topic on its own callback queue, served by its
+own thread as soon as a message arrives, instead of by the
+node's spin loop. Measures how long a trigger takes from
+roscpp receiving it to the handler having run. Triggers
+that come faster than the camera can take frames are held
+back by a TriggerGovernor.
+===========================================================*/
+
+#include "avt_camera_streaming/TriggerListener.h"
+#include <algorithm>
+#include <chrono>
+#include "ros/console.h"
+#include "std_msgs/Float64.h"
+#include "avt_camera_streaming/ThreadTuning.h"
+
+static uint64_t NowNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TriggerListener::TriggerListener(ros::NodeHandle nh, ros::NodeHandle private_nh, const Handler &handler, const std::string &topic)
+    : handler(handler), running(true)
+{
+    if(private_nh.getParam("trigger_priority", priority))
+    {
+        ROS_INFO("Got trigger_priority %i", priority);
+    }
+    else
+    {
+        priority = 0;
+        ROS_INFO("param 'trigger_priority' not set, normal scheduling");
+    }
+    if(private_nh.getParam("trigger_cpu", cpu))
+    {
+        ROS_INFO("Got trigger_cpu %i", cpu);
+    }
+    else
+    {
+        cpu = -1;
+        ROS_INFO("param 'trigger_cpu' not set, trigger thread not pinned");
+    }
+    std::string governor_mode;
+    GovernorMode mode = GOVERNOR_REJECT;
+    if(private_nh.getParam("trigger_governor", governor_mode))
+    {
+        if (!ParseGovernorMode(governor_mode, mode))
+        {
+            ROS_ERROR("unknown trigger_governor '%s', using reject", governor_mode.c_str());
+        }
+        ROS_INFO("trigger_governor is %s", GovernorModeName(mode));
+    }
+    else
+    {
+        ROS_INFO("param 'trigger_governor' not set, rejecting triggers that come too early");
+    }
+    governor.SetMode(mode);
+    // latched: a scheduler that connects later still learns the limit
+    rate_pub = nh.advertise<std_msgs::Float64>(topic + "_rate_limit", 1, true);
+    // Only this subscription uses the queue. Nagle would hold a small trigger message back
+    // for up to the delayed ACK timeout of the publisher's host.
+    nh.setCallbackQueue(&queue);
+    sub = nh.subscribe(topic, 1, &TriggerListener::triggerCb, this, ros::TransportHints().tcpNoDelay());
+
+    thread = std::thread(&TriggerListener::Run, this);
+    if (!PinThread(thread, cpu))
+    {
+        ROS_ERROR("failed to pin the trigger thread to cpu %d", cpu);
+    }
+    if (!SetFifoPriority(thread, priority))
+    {
+        ROS_WARN("cannot give the trigger thread SCHED_FIFO priority %d, needs CAP_SYS_NICE or an rtprio limit", priority);
+    }
+}
+
+TriggerListener::~TriggerListener()
+{
+    sub.shutdown();
+    running = false;
+    thread.join();
+}
+
+void TriggerListener::SetMinPeriod(double period_s)
+{
+    governor.SetMinPeriod(period_s);
+    std_msgs::Float64 rate;
+    rate.data = period_s > 0 ? 1.0 / period_s : 0.0;
+    rate_pub.publish(rate);
+    if (period_s > 0)
+    {
+        ROS_INFO("trigger: the camera takes at most %.2f frames/s (%.3f ms apart)", rate.data, period_s * 1e3);
+    }
+}
+
+void TriggerListener::Run()
+{
+    while (running)
+    {
+        // returns as soon as a message is queued; the timeout only bounds how long the destructor
+        // waits, or how long until a coalesced trigger is due
+        double wait_s = 0.1;
+        if (governor.Deferred())
+        {
+            const uint64_t now_ns = NowNs();
+            const uint64_t due_ns = governor.DueNs();
+            if (now_ns >= due_ns)
+            {
+                std::lock_guard<std::mutex> lock(fire_mutex);
+                // a generator tick may have gone out in the meantime
+                if (governor.Deferred())
+                {
+                    handler();
+                    governor.Sent(now_ns);
+                }
+                continue;
+            }
+            wait_s = std::min(wait_s, (due_ns - now_ns) / 1e9);
+        }
+        queue.callAvailable(ros::WallDuration(wait_s));
+    }
+}
+
+TriggerGovernor::Decision TriggerListener::Govern(uint64_t now_ns)
+{
+    const TriggerGovernor::Decision decision = governor.OnTrigger(now_ns);
+    switch (decision)
+    {
+    case TriggerGovernor::REJECT:
+        ROS_WARN_THROTTLE(5.0, "trigger: %.3f ms apart at most, rejecting earlier ones", governor.MinPeriod() * 1e3);
+        break;
+    case TriggerGovernor::DEFER:
+        ROS_WARN_THROTTLE(5.0, "trigger: %.3f ms apart at most, coalescing earlier ones", governor.MinPeriod() * 1e3);
+        break;
+    default:
+        handler();
+        governor.Sent(now_ns);
+        break;
+    }
+    return decision;
+}
+
+bool TriggerListener::Fire()
+{
+    std::lock_guard<std::mutex> lock(fire_mutex);
+    return Govern(NowNs()) == TriggerGovernor::SEND;
+}
+
+void TriggerListener::triggerCb(const ros::MessageEvent<std_msgs::String const> &event)
+{
+    const ros::Time received = event.getReceiptTime();
+    std::unique_lock<std::mutex> lock(fire_mutex);
+    const int64_t waited_ns = (ros::Time::now() - received).toNSec();
+    if (TriggerGovernor::SEND != Govern(NowNs()))
+    {
+        return;
+    }
+    lock.unlock();
+    const int64_t total_ns = (ros::Time::now() - received).toNSec();
+    // receipt time and now are the same clock, but under sim time they need not move forward
+    if (waited_ns >= 0 && total_ns >= 0)
+    {
+        dispatch.Add(waited_ns);
+        latency.Add(total_ns);
+    }
+}
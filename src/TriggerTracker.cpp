@@ -0,0 +1,181 @@
+/*=========================================================
+Numbers the software triggers of one camera and matches the
+delivered frames to them in order, so every image can name
+the trigger that made it. Frame ID gaps (frames lost on the
+way) use up their triggers; a trigger sent too long before
+a frame for it to be that frame's, or without a frame for
+too long, was missed by the camera.
+===========================================================*/
+
+#include "avt_camera_streaming/TriggerTracker.h"
+#include "ros/console.h"
+
+const size_t TriggerTracker::CAPACITY;
+
+TriggerTracker::TriggerTracker() : timeout_ns(500000000), min_period_ns(0), latency_floor_ns(0), next_seq(1), waiting(), waiting_first(0),
+    waiting_count(0), stamps(), have_frame_id(false), last_frame_id(0), stats(), reported_missed(0)
+{
+}
+
+void TriggerTracker::Reset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    waiting_first = 0;
+    waiting_count = 0;
+    latency_floor_ns = 0;
+    have_frame_id = false;
+    last_frame_id = 0;
+    stats = TriggerStats();
+    reported_missed = 0;
+}
+
+uint32_t TriggerTracker::OnTrigger(uint64_t sent_ns, const ros::Time &stamp)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Expire(sent_ns);
+    if (waiting_count == CAPACITY)
+    {
+        // far more triggers than frames: the oldest is not going to get one
+        PopWaiting();
+        stats.missed++;
+    }
+    Trigger &trigger = waiting[(waiting_first + waiting_count) % CAPACITY];
+    trigger.seq = next_seq++;
+    trigger.sent_ns = sent_ns;
+    waiting_count++;
+    stamps[trigger.seq % CAPACITY].seq = trigger.seq;
+    stamps[trigger.seq % CAPACITY].stamp = stamp;
+    if (next_seq == 0)
+    {
+        // 0 means no trigger
+        next_seq = 1;
+    }
+    stats.triggers++;
+    return trigger.seq;
+}
+
+void TriggerTracker::Withdraw(uint32_t seq)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    // only the newest can be withdrawn, triggers are sent one at a time
+    if (waiting_count > 0 && Waiting(waiting_count - 1).seq == seq)
+    {
+        waiting_count--;
+        stats.triggers--;
+    }
+}
+
+uint32_t TriggerTracker::OnFrame(bool frame_id_valid, uint64_t frame_id, uint64_t delivered_ns)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Expire(delivered_ns);
+    if (frame_id_valid)
+    {
+        // the frames in the gap were taken for the oldest waiting triggers and never got here
+        if (have_frame_id && frame_id > last_frame_id + 1)
+        {
+            uint64_t lost = frame_id - last_frame_id - 1;
+            while (lost > 0 && waiting_count > 0)
+            {
+                PopWaiting();
+                stats.frames_lost++;
+                lost--;
+            }
+        }
+        have_frame_id = true;
+        last_frame_id = frame_id;
+    }
+    SkipIgnored(delivered_ns);
+    if (waiting_count == 0)
+    {
+        stats.untriggered++;
+        return 0;
+    }
+    const Trigger &trigger = Waiting(0);
+    PopWaiting();
+    stats.matched++;
+    if (delivered_ns >= trigger.sent_ns)
+    {
+        const uint64_t latency_ns = delivered_ns - trigger.sent_ns;
+        latency.Add(latency_ns);
+        // a frame matched to an older trigger than its own only looks slower, so the minimum holds
+        if (latency_floor_ns == 0 || latency_ns < latency_floor_ns)
+        {
+            latency_floor_ns = latency_ns;
+        }
+    }
+    return trigger.seq;
+}
+
+bool TriggerTracker::TriggerStamp(uint32_t seq, ros::Time &stamp) const
+{
+    if (seq == 0)
+    {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    const Stamp &recent = stamps[seq % CAPACITY];
+    if (recent.seq != seq)
+    {
+        return false;
+    }
+    stamp = recent.stamp;
+    return true;
+}
+
+void TriggerTracker::Expire(uint64_t now_ns)
+{
+    while (waiting_count > 0 && now_ns > Waiting(0).sent_ns + timeout_ns)
+    {
+        PopWaiting();
+        stats.missed++;
+    }
+}
+
+void TriggerTracker::SkipIgnored(uint64_t delivered_ns)
+{
+    // A trigger the camera ignored (it came within a frame period of the one before) leaves no
+    // gap in the frame IDs, and with triggers faster than the timeout it would never expire:
+    // every later frame would stay one trigger behind. The oldest waiting trigger cannot have
+    // made this frame if it went out more than a frame period plus the camera's latency before
+    // it, as long as the next one went out early enough to have made it.
+    if (min_period_ns == 0 || latency_floor_ns == 0)
+    {
+        return;
+    }
+    const uint64_t window_ns = min_period_ns + latency_floor_ns;
+    while (waiting_count > 1 && delivered_ns > Waiting(0).sent_ns + window_ns && delivered_ns >= Waiting(1).sent_ns + latency_floor_ns)
+    {
+        PopWaiting();
+        stats.missed++;
+    }
+}
+
+TriggerStats TriggerTracker::GetStats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void TriggerTracker::LogStats() const
+{
+    TriggerStats current = GetStats();
+    if (current.triggers == 0)
+    {
+        return;
+    }
+    ROS_INFO("triggers: %llu sent, %llu got their frame, %llu missed, %llu frames lost on the way, %llu frames without a trigger",
+             (unsigned long long)current.triggers, (unsigned long long)current.matched, (unsigned long long)current.missed,
+             (unsigned long long)current.frames_lost, (unsigned long long)current.untriggered);
+}
+
+void TriggerTracker::CheckMissed()
+{
+    uint64_t missed = GetStats().missed;
+    if (missed != reported_missed)
+    {
+        reported_missed = missed;
+        ROS_WARN_THROTTLE(1.0, "%llu triggers got no frame, the camera was busy or they came faster than it takes frames",
+                          (unsigned long long)missed);
+    }
+}
@@ -0,0 +1,31 @@
+/*=========================================================
+Rig driver: any number of cameras in one process, listed in
+one YAML file (see RigConfig.h and config/rig.yaml). Every
+camera has its own pipeline (frame pool, worker thread,
+publishers) under its namespace; they share one VimbaSystem
+and the conversion thread pool.
+===========================================================*/
+
+#include <string>
+#include <vector>
+#include "ros/ros.h"
+#include "ros/console.h"
+#include "avt_camera_streaming/CameraRig.h"
+#include "avt_camera_streaming/RigConfig.h"
+
+int main( int argc, char* argv[])
+{
+    ros::init(argc, argv, "avt_camera_rig", ros::init_options::AnonymousName);
+    ros::NodeHandle n("~");
+    std::vector<std::string> namespaces = LoadRigConfig(n);
+    if (namespaces.empty())
+    {
+        ROS_ERROR("no cameras, load the rig file into ~ (<rosparam command=\"load\" file=\"...\"/>)");
+    }
+    // topics and <ns>/trigger in <ns>/, parameters in ~<ns>/; trigger fires every camera
+    CameraRig rig(ros::NodeHandle(), n, namespaces);
+    rig.StartAcquisition();
+    // triggers have their own threads, this one only serves the rest (timers, white balance)
+    ros::spin();
+    rig.StopAcquisition();
+}
@@ -0,0 +1,274 @@
+/*=========================================================
+Stereo driver: both cameras of the rig in one process,
+sharing one VimbaSystem and the conversion thread pool.
+Each camera publishes and reads its parameters under its
+own namespace, see ~namespaces. The main images are matched
+by hardware timestamp and published as complete pairs, and
+optionally block matched into a disparity image.
+===========================================================*/
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ros/ros.h"
+#include "ros/console.h"
+#include "avt_camera_streaming/CameraRig.h"
+#include "avt_camera_streaming/StereoPairer.h"
+#include "avt_camera_streaming/StereoDisparity.h"
+#include "avt_camera_streaming/RigConfig.h"
+
+// a rig file with two cameras, or the namespaces of parameters set one by one
+static std::vector<std::string> StereoNamespaces(ros::NodeHandle n)
+{
+    std::vector<std::string> namespaces = LoadRigConfig(n);
+    if (namespaces.size() == 2)
+    {
+        ROS_INFO("Got cameras %s and %s from the rig file", namespaces[0].c_str(), namespaces[1].c_str());
+    }
+    else if(n.getParam("namespaces", namespaces) && namespaces.size() == 2)
+    {
+        ROS_INFO("Got namespaces %s and %s", namespaces[0].c_str(), namespaces[1].c_str());
+    }
+    else
+    {
+        if (!namespaces.empty())
+        {
+            ROS_ERROR("avt_stereo needs exactly two cameras, in namespaces or in the rig file");
+        }
+        namespaces.clear();
+        namespaces.push_back("cam_1");
+        namespaces.push_back("cam_2");
+        ROS_INFO("param 'namespaces' not set, using cam_1 and cam_2");
+    }
+    return namespaces;
+}
+
+// a CameraRig of two, whose images are paired and optionally matched
+class StereoCamera
+{
+public:
+    // topics in <ns>/, parameters in ~<ns>/, only the common trigger
+    StereoCamera() : n("~"), rig(nn, n, StereoNamespaces(n), "avt_camera_img", false)
+    {
+        bool pair_frames;
+        if(n.getParam("pair_frames", pair_frames))
+        {
+            ROS_INFO("pair_frames %s", pair_frames ? "enabled" : "disabled");
+        }
+        else
+        {
+            // without PTP each camera stamps from its own free-running clock and no two frames ever match
+            pair_frames = rig.Camera(0).PtpEnabled() && rig.Camera(1).PtpEnabled();
+            ROS_INFO("param 'pair_frames' not set, pairing %s", pair_frames ? "enabled" : "disabled, the cameras are not both on PTP");
+        }
+        double tolerance_ms;
+        if(n.getParam("pair_tolerance_ms", tolerance_ms))
+        {
+            ROS_INFO("Got pair_tolerance_ms %f", tolerance_ms);
+        }
+        else
+        {
+            tolerance_ms = 5.0;
+            ROS_INFO("param 'pair_tolerance_ms' not set, using 5 ms");
+        }
+        if (pair_frames)
+        {
+            // the first namespace is the left camera
+            AVTCamera *left = &rig.Camera(0);
+            AVTCamera *right = &rig.Camera(1);
+            pairer.reset(new StereoPairer((uint64_t)(tolerance_ms * 1e6),
+                                          std::bind(&AVTCamera::PublishImage, left, std::placeholders::_1, std::placeholders::_2),
+                                          std::bind(&AVTCamera::PublishImage, right, std::placeholders::_1, std::placeholders::_2)));
+            left->SetImageHandler(std::bind(&StereoPairer::Add, pairer.get(), StereoPairer::LEFT, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+            right->SetImageHandler(std::bind(&StereoPairer::Add, pairer.get(), StereoPairer::RIGHT, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        }
+        if (pairer)
+        {
+            rig.Diagnostics().Add("stereo skew", pairer->skew);
+        }
+        setupDisparity();
+    }
+
+    void StartAcquisition()
+    {
+        if (disparity)
+        {
+            disparity->Start();
+        }
+        rig.StartAcquisition();
+    }
+
+    void StopAcquisition()
+    {
+        rig.StopAcquisition();
+        if (pairer)
+        {
+            pairer->LogStats();
+        }
+        if (disparity)
+        {
+            disparity->Stop();
+        }
+    }
+
+private:
+    // ~disparity: the cameras make small rectified mono images, the pairer hands matched
+    // pairs of them to StereoDisparity, which publishes <node namespace>/disparity (and points2)
+    void setupDisparity()
+    {
+        bool enabled;
+        if(n.getParam("disparity", enabled))
+        {
+            ROS_INFO("disparity %s", enabled ? "enabled" : "disabled");
+        }
+        else
+        {
+            enabled = false;
+            ROS_INFO("param 'disparity' not set, no disparity");
+        }
+        if (!enabled)
+        {
+            return;
+        }
+        if (!pairer)
+        {
+            ROS_ERROR("disparity needs pair_frames, no disparity");
+            return;
+        }
+        int downscale;
+        if(n.getParam("disparity_downscale", downscale))
+        {
+            ROS_INFO("Got disparity_downscale %i", downscale);
+        }
+        else
+        {
+            downscale = 1;
+            ROS_INFO("param 'disparity_downscale' not set, using 1");
+        }
+        std::vector<int> roi_param;
+        cv::Rect roi;
+        if(n.getParam("disparity_roi", roi_param) && roi_param.size() == 4)
+        {
+            roi = cv::Rect(roi_param[0], roi_param[1], roi_param[2], roi_param[3]);
+            ROS_INFO("Got disparity_roi %ix%i+%i+%i", roi.width, roi.height, roi.x, roi.y);
+        }
+        else
+        {
+            if (!roi_param.empty())
+            {
+                ROS_ERROR("disparity_roi needs [x, y, width, height]");
+            }
+            ROS_INFO("param 'disparity_roi' not set, matching the whole image");
+        }
+        DisparityParams params;
+        if(n.getParam("min_disparity", params.min_disparity))
+        {
+            ROS_INFO("Got min_disparity %i", params.min_disparity);
+        }
+        else
+        {
+            params.min_disparity = 0;
+            ROS_INFO("param 'min_disparity' not set, using 0");
+        }
+        if(n.getParam("num_disparities", params.num_disparities) && params.num_disparities > 0 && params.num_disparities % 16 == 0)
+        {
+            ROS_INFO("Got num_disparities %i", params.num_disparities);
+        }
+        else
+        {
+            params.num_disparities = 64;
+            ROS_INFO("param 'num_disparities' not set or not a multiple of 16, using 64");
+        }
+        if(n.getParam("block_size", params.block_size) && params.block_size >= 5 && params.block_size % 2 == 1)
+        {
+            ROS_INFO("Got block_size %i", params.block_size);
+        }
+        else
+        {
+            params.block_size = 15;
+            ROS_INFO("param 'block_size' not set or not odd and at least 5, using 15");
+        }
+        if(n.getParam("texture_threshold", params.texture_threshold))
+        {
+            ROS_INFO("Got texture_threshold %i", params.texture_threshold);
+        }
+        else
+        {
+            params.texture_threshold = 10;
+            ROS_INFO("param 'texture_threshold' not set, using 10");
+        }
+        if(n.getParam("uniqueness_ratio", params.uniqueness_ratio))
+        {
+            ROS_INFO("Got uniqueness_ratio %i", params.uniqueness_ratio);
+        }
+        else
+        {
+            params.uniqueness_ratio = 15;
+            ROS_INFO("param 'uniqueness_ratio' not set, using 15");
+        }
+        if(n.getParam("speckle_window_size", params.speckle_window_size))
+        {
+            ROS_INFO("Got speckle_window_size %i", params.speckle_window_size);
+        }
+        else
+        {
+            params.speckle_window_size = 100;
+            ROS_INFO("param 'speckle_window_size' not set, using 100");
+        }
+        if(n.getParam("speckle_range", params.speckle_range))
+        {
+            ROS_INFO("Got speckle_range %i", params.speckle_range);
+        }
+        else
+        {
+            params.speckle_range = 4;
+            ROS_INFO("param 'speckle_range' not set, using 4");
+        }
+
+        int cloud_stride;
+        if(n.getParam("cloud_stride", cloud_stride))
+        {
+            ROS_INFO("Got cloud_stride %i", cloud_stride);
+        }
+        else
+        {
+            cloud_stride = 0;
+            ROS_INFO("param 'cloud_stride' not set, no point cloud");
+        }
+
+        std::function<bool()> wanted = [this] { return disparity && disparity->HasSubscribers(); };
+        for (size_t i = 0; i < rig.Size(); ++i)
+        {
+            if (!rig.Camera(i).EnableMatchImage(downscale, roi, wanted))
+            {
+                ROS_ERROR("disparity needs the calibration of both cameras (~%s/camera_info_url), no disparity", rig.Namespace(i).c_str());
+                return;
+            }
+        }
+        disparity.reset(new StereoDisparity(nn, params, rig.Camera(0).MatchRectifier().Projection(), rig.Camera(1).MatchRectifier().Projection(), cloud_stride));
+        pairer->SetPairHandler(std::bind(&StereoDisparity::Submit, disparity.get(), std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+        rig.Diagnostics().Add("disparity", disparity->match_time);
+        if (cloud_stride > 0)
+        {
+            rig.Diagnostics().Add("point cloud", disparity->cloud_time);
+        }
+    }
+
+    ros::NodeHandle n;   // private parameters
+    ros::NodeHandle nn;  // node namespace, for the trigger topic
+    // declared before the rig, so they outlive the cameras that feed them and its diagnostics
+    std::unique_ptr<StereoPairer> pairer; // NULL with pair_frames off
+    std::unique_ptr<StereoDisparity> disparity; // NULL unless ~disparity
+    CameraRig rig;
+};
+
+int main( int argc, char* argv[])
+{
+    ros::init(argc, argv, "stereo_avt_camera", ros::init_options::AnonymousName);
+    StereoCamera stereo;
+    stereo.StartAcquisition();
+    // triggers have their own thread, this one only serves the rest (timers, white balance)
+    ros::spin();
+    stereo.StopAcquisition();
+}
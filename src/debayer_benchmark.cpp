@@ -0,0 +1,221 @@
+/*=========================================================
+Time the conversion kernels against cv::cvtColor on the
+frame sizes we run the cameras at, the fused debayer +
+rectification against debayering and rectifying one after
+the other, and the disparity to point cloud kernels.
+usage: debayer_benchmark [threads] [iterations]
+That they are exact is checked by test/test_kernels.cpp.
+===========================================================*/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "avt_camera_streaming/BayerKernels.h"
+#include "avt_camera_streaming/DebayerEngine.h"
+#include "avt_camera_streaming/ConversionTable.h"
+#include "avt_camera_streaming/ColorCorrection.h"
+#include "avt_camera_streaming/Rectifier.h"
+#include "avt_camera_streaming/Reprojection.h"
+
+// instruction sets this CPU can run, scalar first
+static std::vector<SimdLevel> AvailableLevels()
+{
+    std::vector<SimdLevel> levels;
+    for (int level = SIMD_NONE; level <= DetectSimdLevel(); ++level)
+    {
+        levels.push_back((SimdLevel)level);
+    }
+    return levels;
+}
+
+static double MsPerFrame(const std::chrono::steady_clock::time_point &start, int iterations)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+}
+
+static void Run(int width, int height, int iterations, const std::vector<SimdLevel> &levels, DebayerEngine &engine)
+{
+    cv::Mat bayer(height, width, CV_8UC1);
+    cv::randu(bayer, 0, 256);
+    cv::Mat out(height, width, CV_8UC3);
+
+    // cv::COLOR_BayerBG2RGB is OpenCV's name for an RGGB mosaic, i.e. BAYER_RG
+    cv::cvtColor(bayer, out, cv::COLOR_BayerBG2RGB);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        cv::cvtColor(bayer, out, cv::COLOR_BayerBG2RGB);
+    }
+    const double cvt_ms = MsPerFrame(start, iterations);
+    std::printf("%4dx%-4d  cvtColor rgb8                  %7.3f ms\n", width, height, cvt_ms);
+
+    for (int e = 0; e < NUM_OUTPUT_ENCODINGS; ++e)
+    {
+        const OutputEncoding encoding = (OutputEncoding)e;
+        cv::Mat dst(height, width, CV_8UC(OutputChannels(encoding)));
+        for (size_t l = 0; l < levels.size(); ++l)
+        {
+            ConvertKernel kernel = SelectBayerKernel(BAYER_RG, encoding, levels[l]);
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; ++i)
+            {
+                kernel(bayer.data, bayer.step, width, height, dst.data, dst.step, 0, height, NULL);
+            }
+            const double ms = MsPerFrame(start, iterations);
+            std::printf("%4dx%-4d  %-6s %-5s 1 thread         %7.3f ms  %5.2fx\n", width, height, SimdLevelName(levels[l]), encoding == OUTPUT_GREEN8 ? "green" : EncodingName(encoding), ms, cvt_ms / ms);
+        }
+    }
+
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        ConvertKernel kernel = SelectPreviewKernel(BAYER_RG, OUTPUT_RGB8, levels[l]);
+        cv::Mat preview(height / 2, width / 2, CV_8UC3);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            kernel(bayer.data, bayer.step, width, height, preview.data, preview.step, 0, preview.rows, NULL);
+        }
+        const double ms = MsPerFrame(start, iterations);
+        std::printf("%4dx%-4d  %-6s preview rgb8 1 thread  %7.3f ms  %5.2fx\n", width, height, SimdLevelName(levels[l]), ms, cvt_ms / ms);
+    }
+
+    ColorCorrection correction;
+    correction.Configure(2.2, 12);
+    correction.SetGains(1.8, 1.0, 1.4);
+    std::shared_ptr<const ColorLut> lut = correction.Current();
+    ConvertKernel corrected = SelectBayerKernel(BAYER_RG, OUTPUT_RGB8, levels.back(), true);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        corrected(bayer.data, bayer.step, width, height, out.data, out.step, 0, height, lut.get());
+    }
+    double ms = MsPerFrame(start, iterations);
+    std::printf("%4dx%-4d  wb+gamma rgb8 1 thread        %7.3f ms  %5.2fx\n", width, height, ms, cvt_ms / ms);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        engine.Convert(bayer, out, corrected, lut.get());
+    }
+    ms = MsPerFrame(start, iterations);
+    std::printf("%4dx%-4d  wb+gamma rgb8 %2d threads      %7.3f ms  %5.2fx\n", width, height, ThreadPool::Shared().ThreadCount(), ms, cvt_ms / ms);
+
+    // what the node runs for a BayerRG8 camera
+    ConvertKernel best = ConversionTable().Find(VmbPixelFormatBayerRG8, OUTPUT_RGB8);
+    engine.Convert(bayer, out, best);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        engine.Convert(bayer, out, best);
+    }
+    const double engine_ms = MsPerFrame(start, iterations);
+    std::printf("%4dx%-4d  DebayerEngine rgb8 %2d threads %7.3f ms  %5.2fx\n", width, height, ThreadPool::Shared().ThreadCount(), engine_ms, cvt_ms / engine_ms);
+}
+
+// a wide-angle lens with some barrel distortion and a slightly rotated rectified frame
+static sensor_msgs::CameraInfo SyntheticCalibration(int width, int height)
+{
+    sensor_msgs::CameraInfo info;
+    info.width = width;
+    info.height = height;
+    info.distortion_model = "plumb_bob";
+    const double d[] = { -0.28, 0.09, 0.0008, -0.0005, 0.0 };
+    info.D.assign(d, d + 5);
+    const double f = 0.6 * width, cx = 0.5 * width, cy = 0.5 * height;
+    const double K[] = { f, 0, cx,  0, f, cy,  0, 0, 1 };
+    const double c = 0.99995, s = 0.01;
+    const double R[] = { c, 0, s,  0, 1, 0,  -s, 0, c };
+    const double P[] = { f, 0, cx, 0,  0, f, cy, 0,  0, 0, 1, 0 };
+    std::copy(K, K + 9, info.K.begin());
+    std::copy(R, R + 9, info.R.begin());
+    std::copy(P, P + 12, info.P.begin());
+    return info;
+}
+
+// DebayerEngine followed by a plain cv::remap, by Rectifier::Remap, and fused in ConvertRemap
+static void RunRectification(int width, int height, int iterations, DebayerEngine &engine)
+{
+    const sensor_msgs::CameraInfo info = SyntheticCalibration(width, height);
+    Rectifier rectifier;
+    if (!rectifier.Configure(info))
+    {
+        std::printf("%4dx%-4d  rectification: configure failed\n", width, height);
+        return;
+    }
+    cv::Mat bayer(height, width, CV_8UC1);
+    cv::randu(bayer, 0, 256);
+    ConvertKernel best = ConversionTable().Find(VmbPixelFormatBayerRG8, OUTPUT_RGB8);
+    cv::Mat color(height, width, CV_8UC3), separate(height, width, CV_8UC3), fused(height, width, CV_8UC3);
+    cv::Mat map_xy, map_w, reference;
+    cv::initUndistortRectifyMap(cv::Mat(3, 3, CV_64F, (void*)&info.K[0]), cv::Mat(info.D), cv::Mat(3, 3, CV_64F, (void*)&info.R[0]),
+                                cv::Mat(3, 4, CV_64F, (void*)&info.P[0]), cv::Size(width, height), CV_16SC2, map_xy, map_w);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        engine.Convert(bayer, color, best);
+        cv::remap(color, reference, map_xy, map_w, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+    }
+    const double plain_ms = MsPerFrame(start, iterations);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        engine.Convert(bayer, color, best);
+        rectifier.Remap(color, separate);
+    }
+    const double banded_ms = MsPerFrame(start, iterations);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+    {
+        rectifier.ConvertRemap(bayer, fused, best, NULL);
+    }
+    const double fused_ms = MsPerFrame(start, iterations);
+    std::printf("%4dx%-4d  debayer + cv::remap            %7.3f ms\n", width, height, plain_ms);
+    std::printf("%4dx%-4d  debayer + Rectifier::Remap     %7.3f ms  %5.2fx\n", width, height, banded_ms, plain_ms / banded_ms);
+    std::printf("%4dx%-4d  Rectifier::ConvertRemap fused  %7.3f ms  %5.2fx\n", width, height, fused_ms, plain_ms / fused_ms);
+}
+
+// every reprojection kernel on a disparity image with invalid pixels: a whole cloud at stride 1
+static void RunReprojection(int width, int height, int iterations, const std::vector<SimdLevel> &levels)
+{
+    // a 12 cm baseline, disparities up to 64 px and some invalid (-1)
+    const float f = 0.6f * width, cx = 0.5f * width, cy = 0.5f * height, baseline = 0.12f;
+    const float q[16] = { 1, 0, 0, -cx,  0, 1, 0, -cy,  0, 0, 0, f,  0, 0, 1 / baseline, 0 };
+    cv::Mat disparity(height, width, CV_32F);
+    cv::randu(disparity, -1, 64);
+    std::vector<float> xyz(3 * (size_t)width * height);
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        ReprojectKernel kernel = SelectReprojectKernel(levels[l]);
+        size_t points = 0;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i)
+        {
+            points = 0;
+            for (int v = 0; v < height; ++v)
+            {
+                points += kernel(disparity.ptr<float>(v), width, 0, 1, v, q, 0, xyz.data() + 3 * points);
+            }
+        }
+        std::printf("%4dx%-4d  %-6s reprojection 1 thread  %7.3f ms  %zu points\n", width, height, SimdLevelName(levels[l]), MsPerFrame(start, iterations), points);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int threads = argc > 1 ? std::atoi(argv[1]) : 0;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 200;
+
+    std::vector<SimdLevel> levels = AvailableLevels();
+    ThreadPool::Shared().Configure(threads);
+    DebayerEngine engine;
+    std::printf("CPU supports %s, %d iterations\n", SimdLevelName(DetectSimdLevel()), iterations);
+    Run(688, 512, iterations, levels, engine);
+    Run(1600, 1200, iterations, levels, engine);
+    RunRectification(688, 512, iterations, engine);
+    RunRectification(1600, 1200, iterations, engine);
+    RunReprojection(688, 512, iterations, levels);
+}
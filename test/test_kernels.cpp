@@ -0,0 +1,169 @@
+/*=========================================================
+The conversion, rectification and reprojection kernels
+must give exactly what their references give, on every
+instruction set this CPU runs, at odd sizes and split into
+bands. Timing is debayer_benchmark's job.
+===========================================================*/
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/calib3d/calib3d.hpp"
+#include "avt_camera_streaming/BayerKernels.h"
+#include "avt_camera_streaming/DebayerEngine.h"
+#include "avt_camera_streaming/ConversionTable.h"
+#include "avt_camera_streaming/ColorCorrection.h"
+#include "avt_camera_streaming/Rectifier.h"
+#include "avt_camera_streaming/Reprojection.h"
+
+namespace
+{
+// instruction sets this CPU can run, scalar first
+std::vector<SimdLevel> AvailableLevels()
+{
+    std::vector<SimdLevel> levels;
+    for (int level = SIMD_NONE; level <= DetectSimdLevel(); ++level)
+    {
+        levels.push_back((SimdLevel)level);
+    }
+    return levels;
+}
+
+// run a kernel in two bands and compare with the reference output
+bool Matches(const cv::Mat &bayer, const cv::Mat &reference, ConvertKernel kernel, const ColorLut *lut = NULL)
+{
+    if (reference.empty())
+    {
+        return true;
+    }
+    cv::Mat out(reference.rows, reference.cols, reference.type(), cv::Scalar::all(0));
+    const int split = reference.rows / 2;
+    kernel(bayer.data, bayer.step, bayer.cols, bayer.rows, out.data, out.step, 0, split, lut);
+    kernel(bayer.data, bayer.step, bayer.cols, bayer.rows, out.data, out.step, split, reference.rows, lut);
+    return cv::norm(reference, out, cv::NORM_INF) == 0;
+}
+
+// a wide-angle lens with some barrel distortion and a slightly rotated rectified frame
+sensor_msgs::CameraInfo SyntheticCalibration(int width, int height)
+{
+    sensor_msgs::CameraInfo info;
+    info.width = width;
+    info.height = height;
+    info.distortion_model = "plumb_bob";
+    const double d[] = { -0.28, 0.09, 0.0008, -0.0005, 0.0 };
+    info.D.assign(d, d + 5);
+    const double f = 0.6 * width, cx = 0.5 * width, cy = 0.5 * height;
+    const double K[] = { f, 0, cx,  0, f, cy,  0, 0, 1 };
+    const double c = 0.99995, s = 0.01;
+    const double R[] = { c, 0, s,  0, 1, 0,  -s, 0, c };
+    const double P[] = { f, 0, cx, 0,  0, f, cy, 0,  0, 0, 1, 0 };
+    std::copy(K, K + 9, info.K.begin());
+    std::copy(R, R + 9, info.R.begin());
+    std::copy(P, P + 12, info.P.begin());
+    return info;
+}
+
+const int SIZES[][2] = { { 688, 512 }, { 1600, 1200 }, { 37, 23 }, { 65, 9 }, { 34, 7 }, { 2, 2 }, { 3, 1 } };
+}
+
+// every specialized kernel against DebayerReference / PreviewReference, plain and with white balance and gamma
+TEST(BayerKernels, MatchReference)
+{
+    const std::vector<SimdLevel> levels = AvailableLevels();
+    ColorCorrection correction;
+    correction.Configure(2.2, 12);
+    correction.SetGains(1.8, 1.0, 1.4);
+    std::shared_ptr<const ColorLut> lut = correction.Current();
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); ++s)
+    {
+        const int width = SIZES[s][0], height = SIZES[s][1];
+        cv::Mat bayer(height, width, CV_8UC1);
+        cv::randu(bayer, 0, 256);
+        for (int p = 0; p < NUM_BAYER_PATTERNS; ++p)
+        {
+            for (int e = 0; e < NUM_OUTPUT_ENCODINGS; ++e)
+            {
+                const BayerPattern pattern = (BayerPattern)p;
+                const OutputEncoding encoding = (OutputEncoding)e;
+                const int type = CV_8UC(OutputChannels(encoding));
+                cv::Mat reference(height, width, type), lut_reference(height, width, type);
+                DebayerReference(bayer.data, bayer.step, width, height, reference.data, reference.step, 0, height, pattern, encoding);
+                DebayerReference(bayer.data, bayer.step, width, height, lut_reference.data, lut_reference.step, 0, height, pattern, encoding, lut.get());
+                cv::Mat preview_reference(height / 2, width / 2, type), lut_preview_reference(height / 2, width / 2, type);
+                PreviewReference(bayer.data, bayer.step, width, height, preview_reference.data, preview_reference.step, 0, height / 2, pattern, encoding);
+                PreviewReference(bayer.data, bayer.step, width, height, lut_preview_reference.data, lut_preview_reference.step, 0, height / 2, pattern, encoding, lut.get());
+                for (size_t l = 0; l < levels.size(); ++l)
+                {
+                    SCOPED_TRACE(testing::Message() << SimdLevelName(levels[l]) << ", " << width << "x" << height << ", pattern " << p << ", encoding " << e);
+                    EXPECT_TRUE(Matches(bayer, reference, SelectBayerKernel(pattern, encoding, levels[l])));
+                    EXPECT_TRUE(Matches(bayer, preview_reference, SelectPreviewKernel(pattern, encoding, levels[l])));
+                    EXPECT_TRUE(Matches(bayer, lut_reference, SelectBayerKernel(pattern, encoding, levels[l], true), lut.get()));
+                    EXPECT_TRUE(Matches(bayer, lut_preview_reference, SelectPreviewKernel(pattern, encoding, levels[l], true), lut.get()));
+                }
+            }
+        }
+    }
+}
+
+// Remap and the fused ConvertRemap must give exactly DebayerEngine followed by a plain cv::remap
+TEST(Rectifier, MatchesRemap)
+{
+    DebayerEngine engine;
+    ConvertKernel best = ConversionTable().Find(VmbPixelFormatBayerRG8, OUTPUT_RGB8);
+    const int sizes[][2] = { { 688, 512 }, { 65, 9 } };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+        const int width = sizes[s][0], height = sizes[s][1];
+        SCOPED_TRACE(testing::Message() << width << "x" << height);
+        const sensor_msgs::CameraInfo info = SyntheticCalibration(width, height);
+        Rectifier rectifier;
+        ASSERT_TRUE(rectifier.Configure(info));
+        cv::Mat bayer(height, width, CV_8UC1);
+        cv::randu(bayer, 0, 256);
+        cv::Mat color(height, width, CV_8UC3), separate(height, width, CV_8UC3), fused(height, width, CV_8UC3);
+        cv::Mat map_xy, map_w, reference;
+        cv::initUndistortRectifyMap(cv::Mat(3, 3, CV_64F, (void*)&info.K[0]), cv::Mat(info.D), cv::Mat(3, 3, CV_64F, (void*)&info.R[0]),
+                                    cv::Mat(3, 4, CV_64F, (void*)&info.P[0]), cv::Size(width, height), CV_16SC2, map_xy, map_w);
+        engine.Convert(bayer, color, best);
+        cv::remap(color, reference, map_xy, map_w, cv::INTER_LINEAR, cv::BORDER_CONSTANT);
+        rectifier.Remap(color, separate);
+        rectifier.ConvertRemap(bayer, fused, best, NULL);
+        EXPECT_EQ(0, cv::norm(reference, separate, cv::NORM_INF));
+        EXPECT_EQ(0, cv::norm(reference, fused, cv::NORM_INF));
+    }
+}
+
+// every reprojection kernel against ReprojectReference on a disparity image with invalid pixels
+TEST(Reprojection, MatchesReference)
+{
+    const std::vector<SimdLevel> levels = AvailableLevels();
+    const int width = 688, height = 512;
+    // a 12 cm baseline, disparities up to 64 px and some invalid (-1)
+    const float f = 0.6f * width, cx = 0.5f * width, cy = 0.5f * height, baseline = 0.12f;
+    const float q[16] = { 1, 0, 0, -cx,  0, 1, 0, -cy,  0, 0, 0, f,  0, 0, 1 / baseline, 0 };
+    cv::Mat disparity(height, width, CV_32F);
+    cv::randu(disparity, -1, 64);
+    std::vector<float> reference(3 * (size_t)width), xyz(3 * (size_t)width);
+    for (size_t l = 0; l < levels.size(); ++l)
+    {
+        ReprojectKernel kernel = SelectReprojectKernel(levels[l]);
+        for (int v = 0; v < height; ++v)
+        {
+            const size_t expected = ReprojectReference(disparity.ptr<float>(v), width, 0, 1, v, q, 0, reference.data());
+            const size_t points = kernel(disparity.ptr<float>(v), width, 0, 1, v, q, 0, xyz.data());
+            ASSERT_EQ(expected, points) << SimdLevelName(levels[l]) << ", row " << v;
+            ASSERT_EQ(0, std::memcmp(reference.data(), xyz.data(), points * 3 * sizeof(float))) << SimdLevelName(levels[l]) << ", row " << v;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}